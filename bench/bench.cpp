@@ -0,0 +1,248 @@
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iostream>
+#include <numeric>
+#include <optional>
+#include <sstream>
+#include <string_view>
+#include "../k3d/App.h"
+#include "../k3d/Options.h"
+
+namespace {
+    struct Summary {
+        double mean;
+        double p50;
+        double p99;
+        double max;
+    };
+
+    // nearest-rank percentile over a sorted sample
+    double percentile(const std::vector<double> &sorted, double p) {
+        auto rank = static_cast<size_t>(std::ceil(p * static_cast<double>(sorted.size())));
+        return sorted[std::clamp<size_t>(rank, 1, sorted.size()) - 1];
+    }
+
+    Summary summarize(std::vector<double> samples) {
+        if (samples.empty()) {
+            return {};
+        }
+        std::sort(samples.begin(), samples.end());
+        return {
+                .mean = std::accumulate(samples.begin(), samples.end(), 0.0) / static_cast<double>(samples.size()),
+                .p50 = percentile(samples, 0.50),
+                .p99 = percentile(samples, 0.99),
+                .max = samples.back(),
+        };
+    }
+
+    std::string toJson(const Summary &summary) {
+        std::ostringstream out;
+        out << R"({"mean": )" << summary.mean << R"(, "p50": )" << summary.p50 << R"(, "p99": )" << summary.p99
+            << R"(, "max": )" << summary.max << "}";
+        return out.str();
+    }
+
+    // the mode actually in use, null without presentation
+    std::string presentModeJson(std::optional<vk::PresentModeKHR> presentMode) {
+        if (!presentMode) {
+            return "null";
+        }
+        return "\"" + std::string{k3d::presentModeName(*presentMode)} + "\"";
+    }
+
+    void usage(const char *program) {
+        std::cerr << "usage: " << program << " [--frames N] [--duration SECONDS] [--warmup N] [--depth N]\n"
+                  << "       [--resolution WIDTHxHEIGHT] [--present-mode immediate|mailbox|fifo|fifo-relaxed]\n"
+                  << "       [--gpu-fractal sierpinski|carpet|koch] [--headless] [--cache-command-buffers]\n"
+                  << "       [--no-index] [--no-instancing] [--vertex-layout float32|packed|position]\n"
+                  << "       [--lod PIXELS] [--pipeline-cache FILE] [--resize-interval N]\n"
+                  << "       [--record-threads N] [--draws N] [--camera] [--zoom-speed F] [--animate]\n"
+                  << "       [--stream-geometry] [--wireframe] [--image-count N] [--frames-in-flight N]\n"
+                  << "       [--output FILE]" << std::endl;
+    }
+}
+
+int main(int argc, char **argv) {
+    k3d::AppConfig config;
+    config.frameCount = 1000;
+    config.collectFrameStats = true;
+    size_t warmup = 60;
+    std::string output;
+    std::string fractalName = "sierpinski";
+    std::string vertexLayoutName = "packed";
+
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg{argv[i]};
+        bool hasValue = i + 1 < argc;
+        if (arg == "--headless") {
+            config.headless = true;
+        } else if (arg == "--frames" && hasValue) {
+            config.frameCount = std::stoull(argv[++i]);
+        } else if (arg == "--duration" && hasValue) {
+            config.durationSeconds = std::stod(argv[++i]);
+            config.frameCount = 0;
+        } else if (arg == "--warmup" && hasValue) {
+            warmup = std::stoull(argv[++i]);
+        } else if (arg == "--depth" && hasValue) {
+            config.fractalDepth = std::stoi(argv[++i]);
+        } else if (arg == "--resolution" && hasValue) {
+            std::string resolution{argv[++i]};
+            auto x = resolution.find('x');
+            if (x == std::string::npos) {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            config.width = std::stoul(resolution.substr(0, x));
+            config.height = std::stoul(resolution.substr(x + 1));
+        } else if (arg == "--present-mode" && hasValue) {
+            auto presentMode = k3d::parsePresentMode(argv[++i]);
+            if (!presentMode) {
+                usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            config.presentMode = *presentMode;
+        } else if (arg == "--gpu-fractal" && hasValue && k3d::parseFractalKind(argv[i + 1])) {
+            fractalName = argv[++i];
+            config.gpuGeometry = true;
+            config.fractalKind = *k3d::parseFractalKind(fractalName);
+        } else if (arg == "--cache-command-buffers") {
+            config.cacheCommandBuffers = true;
+        } else if (arg == "--no-index") {
+            config.indexedGeometry = false;
+        } else if (arg == "--no-instancing") {
+            config.instancedGeometry = false;
+        } else if (arg == "--vertex-layout" && hasValue && k3d::parseVertexLayout(argv[i + 1])) {
+            vertexLayoutName = argv[++i];
+            config.vertexLayout = *k3d::parseVertexLayout(vertexLayoutName);
+        } else if (arg == "--lod" && hasValue) {
+            config.lodTargetPixels = std::stof(argv[++i]);
+        } else if (arg == "--pipeline-cache" && hasValue) {
+            config.pipelineCachePath = argv[++i];
+        } else if (arg == "--resize-interval" && hasValue) {
+            config.resizeInterval = std::stoull(argv[++i]);
+        } else if (arg == "--record-threads" && hasValue) {
+            config.recordThreads = std::stoul(argv[++i]);
+        } else if (arg == "--draws" && hasValue) {
+            config.drawCount = std::stoul(argv[++i]);
+        } else if (arg == "--camera") {
+            config.camera = true;
+        } else if (arg == "--zoom-speed" && hasValue) {
+            config.camera = true;
+            config.zoomSpeed = std::stod(argv[++i]);
+        } else if (arg == "--animate") {
+            config.animate = true;
+        } else if (arg == "--stream-geometry") {
+            config.streamGeometry = true;
+        } else if (arg == "--wireframe") {
+            config.wireframe = true;
+        } else if (arg == "--image-count" && hasValue) {
+            config.imageCount = std::stoul(argv[++i]);
+        } else if (arg == "--frames-in-flight" && hasValue) {
+            config.framesInFlight = std::stoul(argv[++i]);
+        } else if (arg == "--output" && hasValue) {
+            output = argv[++i];
+        } else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    try {
+        k3d::App app{config};
+        app.run();
+
+        const auto &frames = app.frameStats();
+        std::vector<double> frameTimes;
+        std::vector<double> recordTimes;
+        std::vector<double> drawCounts;
+        for (size_t i = std::min(warmup, frames.size()); i < frames.size(); i++) {
+            frameTimes.push_back(frames[i].frameMilliseconds);
+            recordTimes.push_back(frames[i].recordMilliseconds);
+            drawCounts.push_back(frames[i].drawCount);
+        }
+
+        // latency samples lag behind frames, skip about as many as the warmup frames
+        const auto &latencySamples = app.latencySamples();
+        std::vector<double> latencies(latencySamples.begin() + std::min(warmup, latencySamples.size()),
+                                      latencySamples.end());
+
+        auto memory = app.memoryStats();
+        auto pipelineCache = app.pipelineCacheStats();
+        std::ostringstream json;
+        json << "{\n"
+             << R"(  "device": ")" << app.deviceName() << "\",\n"
+             << R"(  "config": {"fractal": ")" << fractalName << "\""
+             << R"(, "gpuGeometry": )" << (config.gpuGeometry ? "true" : "false")
+             << R"(, "depth": )" << config.fractalDepth
+             << R"(, "lodTargetPixels": )" << config.lodTargetPixels
+             << R"(, "width": )" << config.width << R"(, "height": )" << config.height
+             << R"(, "presentMode": ")" << k3d::presentModeName(config.presentMode) << "\""
+             << R"(, "imageCount": )" << config.imageCount
+             << R"(, "framesInFlight": )" << config.framesInFlight
+             << R"(, "headless": )" << (config.headless ? "true" : "false")
+             << R"(, "cacheCommandBuffers": )" << (config.cacheCommandBuffers ? "true" : "false")
+             << R"(, "indexed": )" << (config.indexedGeometry ? "true" : "false")
+             << R"(, "instanced": )" << (config.instancedGeometry ? "true" : "false")
+             << R"(, "vertexLayout": ")" << vertexLayoutName << "\""
+             << R"(, "resizeInterval": )" << config.resizeInterval
+             << R"(, "recordThreads": )" << config.recordThreads
+             << R"(, "camera": )" << (config.camera ? "true" : "false")
+             << R"(, "zoomSpeed": )" << config.zoomSpeed
+             << R"(, "animate": )" << (config.animate ? "true" : "false")
+             << R"(, "streamGeometry": )" << (config.streamGeometry ? "true" : "false")
+             << R"(, "wireframe": )" << (config.wireframe ? "true" : "false")
+             << R"(, "warmup": )" << warmup << "},\n"
+             << R"(  "frames": )" << frameTimes.size() << ",\n"
+             << R"(  "generatedDepth": )" << app.loadStats().depth << ",\n"
+             << R"(  "vertexCount": )" << app.loadStats().vertexCount << ",\n"
+             << R"(  "vertexBytes": )" << app.loadStats().vertexBytes << ",\n"
+             << R"(  "indexCount": )" << app.loadStats().indexCount << ",\n"
+             << R"(  "instanceCount": )" << app.loadStats().instanceCount << ",\n"
+             << R"(  "drawCount": )" << app.loadStats().drawCount << ",\n"
+             << R"(  "generateMs": )" << app.loadStats().generateMilliseconds << ",\n"
+             << R"(  "uploadMs": )" << app.loadStats().uploadMilliseconds << ",\n"
+             << R"(  "uploadSubmits": )" << app.uploadSubmits() << ",\n"
+             << R"(  "swapChainRecreations": )" << app.swapChainRecreations() << ",\n"
+             << R"(  "presentMode": )" << presentModeJson(app.presentMode()) << ",\n"
+             << R"(  "swapChainImages": )" << app.swapChainImageCount() << ",\n"
+             << R"(  "startupMs": )" << app.loadStats().startupMilliseconds << ",\n"
+             << R"(  "pipelineCache": {"loaded": )" << (pipelineCache.loaded ? "true" : "false")
+             << R"(, "loadedBytes": )" << pipelineCache.loadedBytes
+             << R"(, "pipelines": )" << pipelineCache.pipelineCount
+             << R"(, "creationMs": )" << pipelineCache.creationMilliseconds
+             << R"(, "feedback": )" << (pipelineCache.feedbackSupported ? "true" : "false")
+             << R"(, "hits": )" << pipelineCache.hitCount << "},\n"
+             << R"(  "memory": {"blocks": )" << memory.blockCount
+             << R"(, "allocations": )" << memory.allocationCount
+             << R"(, "blockBytes": )" << memory.blockBytes
+             << R"(, "usedBytes": )" << memory.usedBytes
+             << R"(, "deviceAllocations": )" << memory.deviceAllocations << "},\n"
+             << R"(  "frameTimeMs": )" << toJson(summarize(frameTimes)) << ",\n"
+             << R"(  "recordTimeMs": )" << toJson(summarize(recordTimes)) << ",\n"
+             << R"(  "drawsPerFrame": )" << toJson(summarize(drawCounts)) << ",\n"
+             << R"(  "latencyEnd": ")" << (app.measuresPresentLatency() ? "present" : "complete") << "\",\n"
+             << R"(  "inputLatencyMs": )" << toJson(summarize(latencies)) << ",\n"
+             << R"(  "gpuPassMs": {)";
+        const char *separator = "";
+        for (const auto &[name, samples]: app.gpuProfiler().history()) {
+            json << separator << "\"" << name << "\": " << toJson(summarize({samples.begin(), samples.end()}));
+            separator = ", ";
+        }
+        json << "}\n}\n";
+
+        if (output.empty()) {
+            std::cout << json.str();
+        } else {
+            std::ofstream file(output);
+            if (!file.is_open()) {
+                throw std::runtime_error("failed to open file: " + output);
+            }
+            file << json.str();
+        }
+    } catch (const std::exception &e) {
+        std::cerr << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+    return EXIT_SUCCESS;
+}
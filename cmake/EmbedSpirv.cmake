@@ -0,0 +1,37 @@
+# Turns a SPIR-V binary into a header with the words as a constexpr array, so shaders are compiled into the binary.
+# Usage: cmake -DSPIRV=<file.spv> -DHEADER=<file.h> -DSYMBOL=<name> -P EmbedSpirv.cmake
+
+file(READ "${SPIRV}" BYTES HEX)
+string(LENGTH "${BYTES}" HEX_LENGTH)
+math(EXPR REMAINDER "${HEX_LENGTH} % 8")
+if (HEX_LENGTH EQUAL 0 OR NOT REMAINDER EQUAL 0)
+    message(FATAL_ERROR "${SPIRV} is not a SPIR-V binary")
+endif ()
+
+# SPIR-V words are little endian in the file, reverse the bytes of every word and wrap lines after 8 words
+string(REGEX REPLACE "([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])([0-9a-f][0-9a-f])"
+        "0x\\4\\3\\2\\1, " WORDS "${BYTES}")
+# CMake regular expressions have no {n} repetition
+string(REPEAT "0x[0-9a-f]+, " 7 LINE_PATTERN)
+string(REGEX REPLACE "(${LINE_PATTERN}0x[0-9a-f]+,) " "\\1\n            " WORDS "${WORDS}")
+string(STRIP "${WORDS}" WORDS)
+string(TOUPPER "${SYMBOL}" GUARD)
+
+get_filename_component(SOURCE_NAME "${SPIRV}" NAME)
+file(WRITE "${HEADER}.tmp" "// generated from ${SOURCE_NAME} by cmake/EmbedSpirv.cmake, do not edit
+#ifndef K3D_SHADERS_${GUARD}_H
+#define K3D_SHADERS_${GUARD}_H
+
+#include <cstdint>
+
+namespace k3d::shaders {
+    alignas(16) inline constexpr uint32_t ${SYMBOL}[] = {
+            ${WORDS}
+    };
+}
+
+#endif //K3D_SHADERS_${GUARD}_H
+")
+# only touch the header when its contents change, so unrelated sources are not rebuilt
+file(COPY_FILE "${HEADER}.tmp" "${HEADER}" ONLY_IF_DIFFERENT)
+file(REMOVE "${HEADER}.tmp")
@@ -3,23 +3,75 @@
 //
 
 #include "App.h"
-#include <ranges>
+#include "Fractal.h"
+#include "ShaderCode.h"
+#include "shaders/triangle.frag.h"
+#include "shaders/triangle.vert.h"
+#include "shaders/triangle_derived.vert.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iostream>
 
 namespace k3d {
+    namespace {
+        const glm::vec2 ROOT_V1{1.0f, 0.9f};
+        const glm::vec2 ROOT_V2{0.0f, -1.0f};
+        const glm::vec2 ROOT_V3{-1.0f, 0.9f};
+    }
+
     void App::run() {
-        while (!window.shouldClose()) {
-            glfwPollEvents();
+        auto start = std::chrono::steady_clock::now();
+        auto frameStart = start;
+        uint64_t frame = 0;
+        for (; config.frameCount == 0 || frame < config.frameCount; ++frame) {
+            if (window) {
+                if (window->shouldClose()) {
+                    break;
+                }
+                glfwPollEvents();
+            }
+            inputTime = std::chrono::steady_clock::now();
+            lastRecordMilliseconds = 0.0;
+            if (config.resizeInterval > 0 && frame > 0 && frame % config.resizeInterval == 0) {
+                bool shrink = frame / config.resizeInterval % 2 == 1;
+                resize({shrink ? config.width * 3 / 4 : config.width, shrink ? config.height * 3 / 4 : config.height});
+            }
+            updateView();
             drawFrame();
+
+            auto frameEnd = std::chrono::steady_clock::now();
+            if (config.collectFrameStats) {
+                std::chrono::duration<double, std::milli> frameTime = frameEnd - frameStart;
+                frames.push_back({frameTime.count(), lastRecordMilliseconds, static_cast<uint32_t>(drawList.size())});
+            }
+            frameStart = frameEnd;
+            if (config.durationSeconds > 0.0 &&
+                std::chrono::duration<double>(frameEnd - start).count() >= config.durationSeconds) {
+                ++frame;
+                break;
+            }
         }
         device.device().waitIdle();
+
+        if (device.isHeadless()) {
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            std::cerr << "rendered " << frame << " frames in " << elapsed.count() << "s ("
+                      << static_cast<double>(frame) / elapsed.count() << " fps)" << std::endl;
+        }
     }
 
     vk::UniquePipelineLayout App::createPipelineLayout() {
+        vk::PushConstantRange pushConstantRange{
+                .stageFlags = vk::ShaderStageFlagBits::eVertex,
+                .offset = 0,
+                .size = sizeof(ViewTransform),
+        };
         vk::PipelineLayoutCreateInfo layout{
-                .setLayoutCount = 0,
-                .pSetLayouts = nullptr,
-                .pushConstantRangeCount = 0,
-                .pPushConstantRanges = nullptr,
+                .setLayoutCount = 1,
+                .pSetLayouts = &frameSetLayout.get(),
+                .pushConstantRangeCount = 1,
+                .pPushConstantRanges = &pushConstantRange,
         };
         try {
             return device.device().createPipelineLayoutUnique(layout);
@@ -28,43 +80,144 @@ namespace k3d {
         }
     }
 
-    std::unique_ptr<Pipeline> App::createPipeline() {
-        auto pipelineConfig = Pipeline::defaultConfig(swapchain->width(), swapchain->height());
+    Pipeline *App::createPipeline() {
+        auto layout = gpuFractal ? VertexLayout::Float32 : config.vertexLayout;
+        auto pipelineConfig = Pipeline::defaultConfig();
+        pipelineConfig.bindingDescriptions = Model::Vertex::getBindingDescriptions(layout);
+        pipelineConfig.attributeDescriptions = Model::Vertex::getAttributeDescriptions(layout);
         pipelineConfig.renderPass = swapchain->getRenderPass();
         pipelineConfig.pipelineLayout = pipelineLayout.get();
-        return std::make_unique<Pipeline>(device,
-                                          "shaders/triangle.vert.spv",
-                                          "shaders/triangle.frag.spv",
-                                          pipelineConfig);
+        if (config.wireframe) {
+            pipelineConfig.rasterizationInfo.polygonMode = vk::PolygonMode::eLine;
+        }
+        auto vertCode = layout == VertexLayout::PositionOnly
+                        ? ShaderCode{"triangle_derived.vert.spv", shaders::triangle_derived_vert}
+                        : ShaderCode{"triangle.vert.spv", shaders::triangle_vert};
+        return &pipelines->get(vertCode.code(),
+                               ShaderCode{"triangle.frag.spv", shaders::triangle_frag}.code(),
+                               pipelineConfig);
     }
 
-    App::App() {
-        model = loadModels();
+    App::App(const AppConfig &config)
+            : config{config},
+              window{config.headless ? nullptr : std::make_unique<Window>(static_cast<int>(config.width),
+                                                                            static_cast<int>(config.height),
+                                                                            "first app")} {
+        if (config.gpuGeometry) {
+            // buffer and pipeline setup only, the dispatches are recorded into the first frame
+            auto generateStart = std::chrono::steady_clock::now();
+            gpuFractal = std::make_unique<GpuFractal>(device, config.fractalKind, config.fractalDepth);
+            load.generateMilliseconds = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - generateStart).count();
+            load.vertexCount = static_cast<uint32_t>(gpuFractal->vertexCount());
+            load.vertexBytes = gpuFractal->vertexCount() * sizeof(Model::Vertex);
+            load.drawCount = 1;
+            load.depth = config.fractalDepth;
+        } else {
+            // the caller takes part in every parallelFor(), so one worker less than there are hardware threads
+            generateJobs = std::make_unique<JobSystem>(std::max(1u, std::thread::hardware_concurrency()) - 1);
+            if (config.lodTargetPixels <= 0.0f) {
+                model = loadModels(config.fractalDepth);
+                modelDepth = config.fractalDepth;
+            }
+        }
+        // with LOD the model is loaded once the swapchain extent is known, see updateLod()
+        if (config.recordThreads > 0 && !config.cacheCommandBuffers && !gpuFractal) {
+            jobs = std::make_unique<JobSystem>(config.recordThreads);
+        }
+        frameSetLayout = UniformRing::createSetLayout(device, vk::ShaderStageFlagBits::eVertex);
         pipelineLayout = createPipelineLayout();
+        if (config.wireframe && !device.fillModeNonSolidSupported()) {
+            throw std::runtime_error("wireframe needs the fillModeNonSolid device feature");
+        }
+        if (config.framesInFlight == 0) {
+            throw std::runtime_error("framesInFlight must be at least 1");
+        }
+        slotInputTimes.resize(config.framesInFlight);
+        profiler = std::make_unique<GpuProfiler>(device, config.framesInFlight,
+                                                 config.gpuTimingLogInterval);
+        createFramePools();
         recreateSwapChain();
-        commandBuffers = createCommandBuffers();
+
+        load.startupMilliseconds = std::chrono::duration<double, std::milli>(
+                std::chrono::steady_clock::now() - startupBegin).count();
+        auto cacheStats = device.pipelineCache().stats();
+        std::cerr << "startup: " << load.startupMilliseconds << "ms, pipeline cache "
+                  << (cacheStats.loaded ? "warm" : "cold") << ", " << cacheStats.pipelineCount << " pipelines in "
+                  << cacheStats.creationMilliseconds << "ms";
+        if (cacheStats.feedbackSupported) {
+            std::cerr << ", " << cacheStats.hitCount << " cache hits";
+        }
+        std::cerr << std::endl;
     }
 
     void App::drawFrame() {
+        // before acquiring, so samples do not include the time acquireNextImage() blocks for an image
+        if (config.collectFrameStats) {
+            collectLatency();
+        }
         uint32_t imageIndex;
         auto result = swapchain->acquireNextImage(imageIndex);
+        releaseRetired();
         if (result == vk::Result::eErrorOutOfDateKHR) {
             recreateSwapChain();
             return;
         } else if (result != vk::Result::eSuccess && result != vk::Result::eSuboptimalKHR) {
             throw std::runtime_error("failed to acquire next image");
         }
-        recordCommandBuffer(commandBuffers[imageIndex].get(), imageIndex);
+        // the slot's previous frame has completed: acquireNextImage() waited on the frame slot's fence and on the
+        // fence of the last frame rendered to the image, which keys the slots in the cached mode
+        auto slot = config.cacheCommandBuffers ? imageIndex : static_cast<uint32_t>(swapchain->getCurrentFrame());
+        updateFrameUniforms(slot);
+        streamGeometry(slot);
+        vk::CommandBuffer cmd;
+        if (config.cacheCommandBuffers) {
+            cmd = commandBuffers[imageIndex].get();
+        } else {
+            // acquireNextImage() has waited on the slot's fence, so nothing allocated from its pool is pending
+            auto &pools = framePools[swapchain->getCurrentFrame()];
+            for (auto &pool: pools) {
+                pool->reset();
+            }
+            cmd = pools[0]->allocate();
+        }
+        if (!config.cacheCommandBuffers || commandBufferDirty[imageIndex]) {
+            auto recordStart = std::chrono::steady_clock::now();
+            recordCommandBuffer(cmd, imageIndex);
+            lastRecordMilliseconds = std::chrono::duration<double, std::milli>(
+                    std::chrono::steady_clock::now() - recordStart).count();
+            if (config.cacheCommandBuffers) {
+                // the buffer that generates the GPU fractal is recorded again without it before its next replay
+                commandBufferDirty[imageIndex] = gpuFractal && !gpuFractalGenerated;
+            }
+        } else {
+            // the replayed buffer resets and rewrites the same queries, read what its previous run left behind
+            profiler->collect(imageIndex);
+            profiler->resubmit(imageIndex);
+        }
+        // counted before submitting, a present error still leaves the frame in flight
+        submittedFrames++;
+        gpuFractalGenerated = gpuFractal != nullptr;
+        auto frameSlot = swapchain->getCurrentFrame();
         try {
-            result = swapchain->submitCommandBuffers(&commandBuffers[imageIndex].get(), imageIndex);
+            result = swapchain->submitCommandBuffers(&cmd, imageIndex, model ? model->uploadValue() : 0);
+            if (config.collectFrameStats && measuresPresentLatency()) {
+                pendingPresents.push_back({swapchain->lastPresentId(), inputTime});
+            } else if (config.collectFrameStats) {
+                slotInputTimes[frameSlot] = inputTime;
+            }
             if (result == vk::Result::eSuboptimalKHR ||
-                window.wasWindowResized()) {
-                window.resetWindowResizedFlag();
+                (window && window->wasWindowResized())) {
+                if (window) {
+                    window->resetWindowResizedFlag();
+                }
                 recreateSwapChain();
                 return;
             }
         } catch (const vk::OutOfDateKHRError &) {
-            window.resetWindowResizedFlag();
+            if (window) {
+                window->resetWindowResizedFlag();
+            }
             recreateSwapChain();
             return;
         } catch (const std::exception &) {
@@ -88,68 +241,337 @@ namespace k3d {
         return commandBuffersV;
     }
 
-    namespace {
-        struct triangle {
-            glm::vec2 v1, v2, v3;
+    void App::createFramePools() {
+        auto graphicsFamily = device.findPhysicalQueueFamilies().graphicsFamily.value();
+        uint32_t threadCount = jobs ? jobs->threadCount() : 1;
+        framePools.resize(config.framesInFlight);
+        for (auto &pools: framePools) {
+            for (uint32_t thread = 0; thread < threadCount; thread++) {
+                pools.push_back(std::make_unique<FrameCommandPool>(device, graphicsFamily));
+            }
+        }
+    }
+
+    std::unique_ptr<Model> App::loadModels(int depth) {
+        return uploadModel(generateModel(depth));
+    }
+
+    App::GeneratedModel App::generateModel(int depth) const {
+        auto generateStart = std::chrono::steady_clock::now();
+        Model::Builder builder;
+        if (config.instancedGeometry) {
+            builder = sierpinskiInstanced(ROOT_V1, ROOT_V2, ROOT_V3, depth,
+                                          sierpinskiBaseDepth(depth, Model::Vertex::size(config.vertexLayout)),
+                                          generateJobs.get());
+        } else {
+            builder.vertices = sierpinski(ROOT_V1, ROOT_V2, ROOT_V3, depth, generateJobs.get());
+        }
+        if (config.indexedGeometry) {
+            builder.weld();
+            builder.optimize();
+        }
+        return {
+                .builder = std::move(builder),
+                .depth = depth,
+                .generateMilliseconds = std::chrono::duration<double, std::milli>(
+                        std::chrono::steady_clock::now() - generateStart).count(),
         };
+    }
 
-        glm::vec2 operator/(glm::vec2 v, float n) {
-            return {v.x / n, v.y / n};
+    std::unique_ptr<Model> App::uploadModel(GeneratedModel generated) {
+        const auto &builder = generated.builder;
+        auto uploadStart = std::chrono::steady_clock::now();
+        auto usage = config.streamGeometry ? Model::Usage::Streaming : Model::Usage::Static;
+        auto result = std::make_unique<Model>(device, builder, usage, config.vertexLayout);
+        auto uploadEnd = std::chrono::steady_clock::now();
+
+        load.generateMilliseconds = generated.generateMilliseconds;
+        load.uploadMilliseconds = std::chrono::duration<double, std::milli>(uploadEnd - uploadStart).count();
+        load.vertexCount = static_cast<uint32_t>(builder.vertices.size());
+        load.vertexBytes = result->vertexBytes();
+        load.indexCount = static_cast<uint32_t>(builder.indices.size());
+        load.instanceCount = static_cast<uint32_t>(std::max<size_t>(builder.instances.size(), 1));
+        load.depth = generated.depth;
+        return result;
+    }
+
+    bool App::updateLod() {
+        if (gpuFractal || config.lodTargetPixels <= 0.0f) {
+            return false;
+        }
+        double tilePixels = std::ldexp(rootPixels(), -tileLevel());
+        int depth = sierpinskiLodDepth(tilePixels, config.lodTargetPixels, config.fractalDepth);
+        if (pendingLod.valid() && pendingLod.wait_for(std::chrono::seconds{0}) == std::future_status::ready) {
+            auto generated = pendingLod.get();
+            int generatedDepth = generated.depth;
+            lodModels[generatedDepth] = uploadModel(std::move(generated));
+        }
+        if (model && modelDepth == depth) {
+            return false;
         }
 
-        void algorithm(triangle t, std::vector<triangle> &tv, int depth, int n = 0) {
-            if (n >= depth) {
-                tv.push_back(t);
-                return;
+        auto cached = lodModels.find(depth);
+        if (model && cached == lodModels.end()) {
+            // keep drawing the current level until the background generation has finished
+            if (!pendingLod.valid()) {
+                pendingLod = std::async(std::launch::async, [this, depth] { return generateModel(depth); });
             }
-            auto m12 = (t.v1 + t.v2) / 2;
-            auto m13 = (t.v1 + t.v3) / 2;
-            auto m23 = (t.v2 + t.v3) / 2;
-            ++n;
-            algorithm({t.v1, m12, m13}, tv, depth, n);
-            algorithm({t.v2, m12, m23}, tv, depth, n);
-            algorithm({t.v3, m23, m13}, tv, depth, n);
+            return false;
+        }
+        if (model) {
+            lodModels[modelDepth] = std::move(model);
+        }
+        if (cached != lodModels.end()) {
+            model = std::move(cached->second);
+            lodModels.erase(cached);
+        } else {
+            model = loadModels(depth);
         }
+        modelDepth = depth;
+        while (lodModels.size() > LOD_CACHE_SIZE) {
+            // drop the level furthest from the current one, frames in flight may still draw it
+            auto furthest = std::abs(lodModels.begin()->first - depth) > std::abs(lodModels.rbegin()->first - depth)
+                            ? lodModels.begin() : std::prev(lodModels.end());
+            retired.push_back({.submittedFrames = submittedFrames, .model = std::move(furthest->second)});
+            lodModels.erase(furthest);
+        }
+        return true;
+    }
 
-        std::vector<Model::Vertex> sierpinski(glm::vec2 v1, glm::vec2 v2, glm::vec2 v3, int depth) {
-            std::vector<triangle> triangles;
-            std::vector<Model::Vertex> r;
-            algorithm({v1, v2, v3}, triangles, depth, 0);
-            for (auto &i: std::views::reverse(triangles)) {
-                r.push_back({i.v1, {(i.v1.x + 1) / 2, (i.v1.y + 1) / 2, (i.v1.x + i.v1.y + 2) / 4}});
-                r.push_back({i.v2, {(i.v2.x + 1) / 2, (i.v2.y + 1) / 2, (i.v2.x + i.v2.y + 2) / 4}});
-                r.push_back({i.v3, {(i.v3.x + 1) / 2, (i.v3.y + 1) / 2, (i.v3.x + i.v3.y + 2) / 4}});
+    bool App::updateCamera() {
+        if (!config.camera) {
+            return false;
+        }
+        bool moved = false;
+        if (window) {
+            auto input = window->takeMouseInput();
+            if (input.dragX != 0.0 || input.dragY != 0.0) {
+                camera.pan({input.dragX, input.dragY});
+                moved = true;
+            }
+            if (input.scroll != 0.0) {
+                camera.zoomAt({input.cursorX, input.cursorY}, std::pow(ZOOM_STEP, input.scroll));
+                moved = true;
             }
-            return r;
         }
+        if (config.zoomSpeed != 1.0) {
+            camera.zoomAt(camera.toNdc(config.zoomTarget), config.zoomSpeed);
+            moved = true;
+        }
+        return moved;
+    }
+
+    void App::updateView() {
+        bool moved = updateCamera();
+        if (updateLod() || moved) {
+            buildDrawList();
+            invalidateCommandBuffers();
+        }
+    }
+
+    double App::rootPixels() const {
+        // the root triangle spans [-1, 1] x [-1, 0.9] in normalized device coordinates
+        auto extent = swapchain->getSwapChainExtent();
+        double pixels = std::max(extent.width * 1.0, extent.height * 0.95);
+        return config.camera ? pixels * camera.zoom() : pixels;
+    }
+
+    int App::tileLevel() const {
+        if (!config.camera) {
+            return 0;
+        }
+        return std::clamp(static_cast<int>(std::floor(std::log2(rootPixels() / TILE_PIXELS))), 0, MAX_TILE_LEVEL);
+    }
 
+    App::ViewTransform App::tileView(const SierpinskiTile &tile) const {
+        // relative to the camera in double, so only the small on-screen values are narrowed to float
+        auto offset = camera.toNdc(tile.offset);
+        auto scale = static_cast<float>(tile.scale);
+        // sierpinskiColor is affine, see sierpinskiInstanced()
+        return {
+                .offset = glm::vec2{offset},
+                .scale = static_cast<float>(tile.scale * camera.zoom()),
+                .colorScale = scale,
+                .colorBias = sierpinskiColor(glm::vec2{tile.offset}) - sierpinskiColor({0.0f, 0.0f}) * scale,
+        };
     }
 
-    std::unique_ptr<Model> App::loadModels() {
-        std::vector<Model::Vertex> vertices = sierpinski(
-                {1, 0.9},
-                {0.0f, -1.0f},
-                {-1.0f, 0.9f},
-                10
-        );
-        return std::make_unique<Model>(device, vertices);
+    void App::buildDrawList() {
+        drawList.clear();
+        if (!model) {
+            return;
+        }
+        uint64_t instanceCount = model->getInstanceCount();
+        if (config.camera) {
+            glm::dvec2 low;
+            glm::dvec2 high;
+            camera.visibleBounds(low, high);
+            for (const auto &tile: sierpinskiVisibleTiles(glm::dvec2{ROOT_V1}, glm::dvec2{ROOT_V2},
+                                                                 glm::dvec2{ROOT_V3}, tileLevel(), low, high)) {
+                drawList.push_back({0, static_cast<uint32_t>(instanceCount), tileView(tile)});
+            }
+        } else {
+            uint64_t drawCount = std::clamp<uint64_t>(config.drawCount, 1, instanceCount);
+            for (uint64_t i = 0; i < drawCount; i++) {
+                auto first = static_cast<uint32_t>(instanceCount * i / drawCount);
+                auto last = static_cast<uint32_t>(instanceCount * (i + 1) / drawCount);
+                drawList.push_back({first, last - first});
+            }
+        }
+        load.drawCount = static_cast<uint32_t>(drawList.size());
     }
 
-    std::unique_ptr<SwapChain> App::createSwapChain() {
-        auto extent = window.getExtent();
+    uint32_t App::frameSlotCount() const {
+        if (!config.cacheCommandBuffers) {
+            return config.framesInFlight;
+        }
+        return static_cast<uint32_t>(std::max<size_t>(swapchain->imageCount(), config.framesInFlight));
+    }
+
+    void App::updateFrameUniforms(uint32_t slot) {
+        FrameUniforms frame;
+        if (config.animate) {
+            auto time = std::chrono::duration<float>(std::chrono::steady_clock::now() - startupBegin).count();
+            frame.time = time;
+            frame.scale = 1.0f + 0.05f * std::sin(time * 3.0f);
+            frame.colorScale = {0.75f + 0.25f * std::sin(time),
+                                0.75f + 0.25f * std::sin(time + 2.094f),
+                                0.75f + 0.25f * std::sin(time + 4.189f),
+                                1.0f};
+        }
+        uniforms->beginFrame(slot);
+        frameUniformOffset = uniforms->write(frame);
+    }
+
+    void App::streamGeometry(uint32_t slot) {
+        if (!config.streamGeometry || !model) {
+            return;
+        }
+        auto bytes = model->vertexBytes();
+        if (!geometryStream || geometryStream->slotCount() < frameSlotCount() || geometryStream->slotSize() < bytes) {
+            // frames in flight may still read the old ring, a new buffer also needs new command buffers
+            if (geometryStream) {
+                retired.push_back({.submittedFrames = submittedFrames, .geometry = std::move(geometryStream)});
+            }
+            geometryStream = std::make_unique<StreamingBuffer>(device, vk::BufferUsageFlagBits::eVertexBuffer,
+                                                               frameSlotCount(), bytes);
+            invalidateCommandBuffers();
+        }
+
+        // every vertex is pulled towards the origin by a travelling wave, which keeps positions inside [-1, 1]
+        auto time = std::chrono::duration<float>(std::chrono::steady_clock::now() - startupBegin).count();
+        const auto &source = model->sourceVertices();
+        streamedVertices.resize(source.size());
+        for (size_t i = 0; i < source.size(); i++) {
+            auto position = source[i].position;
+            float wave = 0.5f + 0.5f * std::sin(3.0f * time + 8.0f * position.x + 5.0f * position.y);
+            streamedVertices[i] = {.position = position * (1.0f - 0.05f * wave), .color = source[i].color};
+        }
+        geometryStream->beginFrame(slot);
+        model->stream(*geometryStream, streamedVertices);
+    }
+
+    std::unique_ptr<SwapChain> App::createSwapChain(SwapChain *previous) {
+        SwapChainConfig swapChainConfig{
+                .presentMode = config.presentMode,
+                .imageCount = config.imageCount,
+                .framesInFlight = config.framesInFlight,
+        };
+        if (!window) {
+            return std::make_unique<SwapChain>(device, headlessExtent, swapChainConfig, previous);
+        }
+        auto extent = window->getExtent();
         while (extent.width == 0 || extent.height == 0) {
-            extent = window.getExtent();
+            extent = window->getExtent();
             glfwWaitEvents();
         }
-        device.device().waitIdle();
-        return std::make_unique<SwapChain>(device, extent);
+        return std::make_unique<SwapChain>(device, extent, swapChainConfig, previous);
     }
 
     void App::recreateSwapChain() {
-        device.device().waitIdle();
-        swapchain.reset();
-        swapchain = createSwapChain();
-        pipeline = createPipeline();
+        // nothing is waited on here: whatever in-flight frames may still use is retired instead of destroyed
+        RetiredFrameResources previous{.submittedFrames = submittedFrames, .swapchain = std::move(swapchain)};
+        // present ids can only be waited on through the swapchain they were presented to
+        pendingPresents.clear();
+        swapchain = createSwapChain(previous.swapchain.get());
+        if (!pipelines || !previous.swapchain->compareSwapFormats(*swapchain)) {
+            // pipelines are only usable with compatible render passes, new formats start an empty registry
+            previous.pipelines = std::move(pipelines);
+            pipelines = std::make_unique<PipelineRegistry>(device);
+            pipeline = createPipeline();
+        }
+        if (config.cacheCommandBuffers) {
+            // cached buffers may still be pending and reference the old framebuffers, record into new ones
+            previous.commandBuffers = std::move(commandBuffers);
+            commandBuffers = createCommandBuffers();
+            profiler->ensureSlots(static_cast<uint32_t>(swapchain->imageCount()));
+        }
+        if (!uniforms || uniforms->slotCount() < frameSlotCount()) {
+            previous.uniforms = std::move(uniforms);
+            uniforms = std::make_unique<UniformRing>(device, frameSetLayout.get(), frameSlotCount(),
+                                                     FRAME_UNIFORM_BYTES, sizeof(FrameUniforms));
+        }
+        updateLod();
+        buildDrawList();
+        invalidateCommandBuffers();
+        if (previous.swapchain) {
+            retired.push_back(std::move(previous));
+            recreations++;
+        }
+    }
+
+    void App::releaseRetired() {
+        // acquiring frame k waited on the fence of frame k - framesInFlight, the last frame submitted before
+        // retirement is covered from frame submittedFrames + framesInFlight - 1 on
+        while (!retired.empty() &&
+               submittedFrames + 1 >= retired.front().submittedFrames + config.framesInFlight) {
+            // the fences do not cover presents, a retired swapchain also waits for its last present
+            if (retired.front().swapchain && !retired.front().swapchain->presentsCompleted()) {
+                break;
+            }
+            retired.pop_front();
+        }
+    }
+
+    void App::collectLatency() {
+        if (!measuresPresentLatency()) {
+            // acquireNextImage() starts with the same wait, the slot's last frame is sampled as soon as it completes
+            swapchain->waitForFrame();
+            auto now = std::chrono::steady_clock::now();
+            auto &input = slotInputTimes[swapchain->getCurrentFrame()];
+            if (input) {
+                latencies.push_back(std::chrono::duration<double, std::milli>(now - *input).count());
+                input.reset();
+            }
+            return;
+        }
+        // polled once per frame, a present is timed when the first frame after it was displayed starts
+        auto now = std::chrono::steady_clock::now();
+        while (!pendingPresents.empty()) {
+            auto result = swapchain->waitForPresent(pendingPresents.front().presentId, 0);
+            if (result == vk::Result::eTimeout) {
+                break;
+            }
+            // anything other than success means the present will never be seen, e.g. an out of date swapchain
+            if (result == vk::Result::eSuccess) {
+                latencies.push_back(
+                        std::chrono::duration<double, std::milli>(now - pendingPresents.front().inputTime).count());
+            }
+            pendingPresents.pop_front();
+        }
+    }
+
+    void App::resize(vk::Extent2D extent) {
+        if (window) {
+            window->resize(static_cast<int>(extent.width), static_cast<int>(extent.height));
+            return;
+        }
+        headlessExtent = extent;
+        recreateSwapChain();
+    }
+
+    void App::invalidateCommandBuffers() {
+        commandBufferDirty.assign(commandBuffers.size(), true);
     }
 
     void App::recordCommandBuffer(vk::CommandBuffer cmd, uint32_t imageIndex) {
@@ -159,6 +581,14 @@ namespace k3d {
         } catch (const std::exception &) {
             throw std::runtime_error("failed to begin recording command buffer");
         }
+        if (gpuFractal && !gpuFractalGenerated) {
+            gpuFractal->recordGenerate(cmd);
+        }
+        // cached buffers outlive the frame they were recorded in, so they get a query slot per image
+        auto profilerSlot = config.cacheCommandBuffers ? imageIndex
+                                                       : static_cast<uint32_t>(swapchain->getCurrentFrame());
+        profiler->beginFrame(cmd, profilerSlot);
+        profiler->beginPass(cmd, "main");
         vk::ArrayWrapper1D<float, 4> colors({0.0, 0.0, 0.0, 1.0});
         std::array<vk::ClearValue, 2> clearValues{};
         clearValues[0].color = vk::ClearColorValue{
@@ -172,11 +602,31 @@ namespace k3d {
                 .clearValueCount = clearValues.size(),
                 .pClearValues = clearValues.data(),
         };
-        cmd.beginRenderPass(renderPassBeginInfo, vk::SubpassContents::eInline);
-        pipeline->bind(cmd);
-        model->bind(cmd);
-        model->draw(cmd);
+        // an empty draw list, e.g. the camera panned off the fractal, records the clear inline: executing zero
+        // secondary buffers is invalid
+        if (jobs && !drawList.empty()) {
+            cmd.beginRenderPass(renderPassBeginInfo, vk::SubpassContents::eSecondaryCommandBuffers);
+            recordSecondaryCommandBuffers(cmd, imageIndex);
+        } else {
+            cmd.beginRenderPass(renderPassBeginInfo, vk::SubpassContents::eInline);
+            bindRenderState(cmd);
+            if (gpuFractal) {
+                // a single float transform, GPU geometry has a fixed depth and no tiles
+                ViewTransform view;
+                if (config.camera) {
+                    auto offset = camera.toNdc({0.0, 0.0});
+                    view.offset = glm::vec2{offset};
+                    view.scale = static_cast<float>(camera.zoom());
+                }
+                cmd.pushConstants(pipelineLayout.get(), vk::ShaderStageFlagBits::eVertex, 0, sizeof(view), &view);
+                gpuFractal->bind(cmd);
+                gpuFractal->draw(cmd);
+            } else {
+                recordDraws(cmd, 0, drawList.size());
+            }
+        }
         cmd.endRenderPass();
+        profiler->endPass(cmd);
         try {
             cmd.end();
         } catch (const std::exception &) {
@@ -184,4 +634,70 @@ namespace k3d {
         }
     }
 
+    void App::recordSecondaryCommandBuffers(vk::CommandBuffer cmd, uint32_t imageIndex) {
+        auto &pools = framePools[swapchain->getCurrentFrame()];
+        auto chunkCount = static_cast<uint32_t>(
+                std::min<size_t>(drawList.size(), jobs->threadCount() * CHUNKS_PER_THREAD));
+        secondaryBuffers.assign(chunkCount, {});
+        vk::CommandBufferInheritanceInfo inheritanceInfo{
+                .renderPass = swapchain->getRenderPass(),
+                .subpass = 0,
+                .framebuffer = swapchain->getFrameBuffer(static_cast<int>(imageIndex)),
+        };
+        vk::CommandBufferBeginInfo beginInfo{
+                .flags = vk::CommandBufferUsageFlagBits::eRenderPassContinue |
+                         vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+                .pInheritanceInfo = &inheritanceInfo,
+        };
+        // each thread only touches its own pool, chunk i covers the i-th slice of the draw list
+        jobs->parallelFor(chunkCount, [&](uint32_t chunk, uint32_t thread) {
+            auto secondary = pools[thread]->allocate(vk::CommandBufferLevel::eSecondary);
+            try {
+                secondary.begin(beginInfo);
+            } catch (const std::exception &) {
+                throw std::runtime_error("failed to begin recording secondary command buffer");
+            }
+            bindRenderState(secondary);
+            recordDraws(secondary, drawList.size() * chunk / chunkCount, drawList.size() * (chunk + 1) / chunkCount);
+            try {
+                secondary.end();
+            } catch (const std::exception &) {
+                throw std::runtime_error("failed to end secondary command buffer");
+            }
+            secondaryBuffers[chunk] = secondary;
+        });
+        cmd.executeCommands(secondaryBuffers);
+    }
+
+    void App::bindRenderState(vk::CommandBuffer cmd) {
+        pipeline->bind(cmd);
+        cmd.bindDescriptorSets(vk::PipelineBindPoint::eGraphics, pipelineLayout.get(), 0, uniforms->descriptorSet(),
+                               frameUniformOffset);
+        auto extent = swapchain->getSwapChainExtent();
+        vk::Viewport viewport{
+                .x = 0.0f,
+                .y = 0.0f,
+                .width = static_cast<float>(extent.width),
+                .height = static_cast<float>(extent.height),
+                .minDepth = 0.0f,
+                .maxDepth = 1.0f,
+        };
+        vk::Rect2D scissor{.offset = {0, 0}, .extent = extent};
+        cmd.setViewport(0, viewport);
+        cmd.setScissor(0, scissor);
+    }
+
+    void App::recordDraws(vk::CommandBuffer cmd, size_t first, size_t last) {
+        if (first == last) {
+            return;
+        }
+        model->bind(cmd);
+        for (size_t i = first; i < last; i++) {
+            const auto &draw = drawList[i];
+            cmd.pushConstants(pipelineLayout.get(), vk::ShaderStageFlagBits::eVertex, 0, sizeof(draw.view),
+                              &draw.view);
+            model->draw(cmd, draw.firstInstance, draw.instanceCount);
+        }
+    }
+
 } // k3d
\ No newline at end of file
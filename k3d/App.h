@@ -6,44 +6,333 @@
 #define K3D_APP_H
 
 #include "Window.h"
+#include "Camera.h"
 #include "Pipeline.h"
+#include "PipelineRegistry.h"
 #include "SwapChain.h"
 #include "Model.h"
+#include "GpuProfiler.h"
+#include "GpuFractal.h"
+#include "Fractal.h"
+#include "FrameCommandPool.h"
+#include "JobSystem.h"
+#include "UniformRing.h"
+#include <chrono>
+#include <deque>
+#include <future>
+#include <map>
 #include <memory>
+#include <optional>
 
 namespace k3d {
 
+    struct AppConfig {
+        uint32_t width = 800;
+        uint32_t height = 600;
+        // render into offscreen images instead of a window surface, no GLFW window is created
+        bool headless = false;
+        // frames drawn before run() returns, 0 keeps drawing until the window is closed
+        uint64_t frameCount = 0;
+        // wall clock seconds after which run() returns, 0 disables the limit
+        double durationSeconds = 0.0;
+        int fractalDepth = 10;
+        // Pick the CPU fractal's depth from the swapchain extent so leaf triangles are about this many pixels
+        // across, regenerating it when the extent changes; fractalDepth is then the deepest level used. 0 always
+        // draws fractalDepth.
+        float lodTargetPixels = 0.0f;
+        // generate the fractal with a compute shader instead of building a Model on the CPU
+        bool gpuGeometry = false;
+        // only sierpinski can be built on the CPU
+        FractalKind fractalKind = FractalKind::Sierpinski;
+        // weld shared corners of the CPU fractal and draw it indexed, in space-filling curve order
+        bool indexedGeometry = true;
+        // draw the CPU fractal as instances of a shallower base mesh, see sierpinskiBaseDepth()
+        bool instancedGeometry = true;
+        // vertex buffer layout of the CPU fractal, GPU geometry is always written as VertexLayout::Float32
+        VertexLayout vertexLayout = VertexLayout::Packed;
+        vk::PresentModeKHR presentMode = vk::PresentModeKHR::eMailbox;
+        // swapchain images, 0 picks the surface's minimum plus one, see SwapChainConfig
+        uint32_t imageCount = 0;
+        // frames recorded ahead of the GPU, every per-frame resource is allocated this many times
+        uint32_t framesInFlight = 2;
+        // record each per-image command buffer once and replay it until the swapchain, model or pipeline changes
+        bool cacheCommandBuffers = false;
+        // keep a FrameStats sample for every drawn frame
+        bool collectFrameStats = false;
+        // read back frames between rolling GPU pass timing log lines, 0 disables the log
+        uint32_t gpuTimingLogInterval = 0;
+        // file the pipeline cache is loaded from and saved to, empty keeps it in memory only
+        std::string pipelineCachePath = "pipeline_cache.bin";
+        // resize storm benchmark: every resizeInterval frames the window or offscreen target alternates between
+        // its configured size and three quarters of it, 0 disables
+        uint64_t resizeInterval = 0;
+        // worker threads recording the draw list into secondary command buffers next to the main thread, 0 records
+        // inline on the main thread; cached command buffers and GPU geometry always record inline
+        uint32_t recordThreads = 0;
+        // draw calls the model's instances are split into, at most one per instance
+        uint32_t drawCount = 1;
+        // Pan with the left mouse button and zoom with the wheel. The CPU fractal is then drawn as the tiles that
+        // intersect the view, each a copy of the current LOD level placed by push constants.
+        bool camera = false;
+        // deep zoom benchmark: the camera zooms by this factor every frame, keeping zoomTarget in place; 1 disables
+        double zoomSpeed = 1.0;
+        // midpoint of the root's right edge, a corner at every depth, so there is structure at any zoom
+        glm::dvec2 zoomTarget{0.5, -0.05};
+        // pulse the scale and cycle the colors of the whole frame through the per-frame uniforms
+        bool animate = false;
+        // Rewrite the CPU fractal's vertices every frame and stream them through a per-frame ring, standing in for
+        // simulated geometry; instances and indices stay static
+        bool streamGeometry = false;
+        // draw triangle edges only, a line polygon mode variant of the same shaders
+        bool wireframe = false;
+    };
+
+    struct FrameStats {
+        double frameMilliseconds;
+        double recordMilliseconds;
+        // draw calls recorded, one per visible tile with the camera
+        uint32_t drawCount;
+    };
+
+    // of the most recently generated model, LOD switches to a cached level leave them unchanged
+    struct LoadStats {
+        double generateMilliseconds;
+        // staging and submitting only, the copies overlap with the first frames
+        double uploadMilliseconds;
+        uint32_t vertexCount;
+        // size of the vertex buffer in its VertexLayout
+        uint64_t vertexBytes;
+        // 0 for non-indexed models
+        uint32_t indexCount;
+        uint32_t instanceCount;
+        uint32_t drawCount;
+        int depth;
+        // from the start of App construction until the swapchain and pipelines are ready
+        double startupMilliseconds;
+    };
+
     class App {
     public:
-        App();
-
-        static constexpr int HEIGHT = 600;
-        static constexpr int WIDTH = 800;
+        explicit App(const AppConfig &config = {});
 
         void run();
 
+        [[nodiscard]] const GpuProfiler &gpuProfiler() const { return *profiler; }
+
+        [[nodiscard]] const std::vector<FrameStats> &frameStats() const { return frames; }
+
+        [[nodiscard]] const LoadStats &loadStats() const { return load; }
+
+        [[nodiscard]] std::string deviceName() const { return device.properties.deviceName; }
+
+        [[nodiscard]] MemoryAllocator::Stats memoryStats() { return device.allocator().stats(); }
+
+        [[nodiscard]] PipelineCache::Stats pipelineCacheStats() { return device.pipelineCache().stats(); }
+
+        [[nodiscard]] uint32_t swapChainRecreations() const { return recreations; }
+
+        [[nodiscard]] uint64_t uploadSubmits() { return device.uploads().submitCount(); }
+
+        [[nodiscard]] size_t swapChainImageCount() { return swapchain->imageCount(); }
+
+        // the present mode in use, which may differ from AppConfig::presentMode; nullopt when headless
+        [[nodiscard]] std::optional<vk::PresentModeKHR> presentMode() const { return swapchain->presentMode(); }
+
+        // Milliseconds from the event poll a frame's input was read in until the frame was displayed, or until
+        // its rendering completed when presents cannot be waited on. Collected with collectFrameStats; a sample is
+        // seen at the next acquire, so it may be late by up to one frame.
+        [[nodiscard]] const std::vector<double> &latencySamples() const { return latencies; }
+
+        // whether latencySamples() end at the present instead of at render completion
+        [[nodiscard]] bool measuresPresentLatency() const { return window && device.presentWaitSupported(); }
+
     private:
+        // resources recorded against a replaced swapchain, destroyed once every frame submitted before the
+        // replacement has completed
+        struct RetiredFrameResources {
+            uint64_t submittedFrames;
+            std::unique_ptr<SwapChain> swapchain;
+            std::unique_ptr<PipelineRegistry> pipelines;
+            std::vector<vk::UniqueCommandBuffer> commandBuffers;
+            std::unique_ptr<Model> model;
+            std::unique_ptr<UniformRing> uniforms;
+            std::unique_ptr<StreamingBuffer> geometry;
+        };
+
+        // set 0, binding 0 of triangle.vert, std140: applied to the whole frame after the view transform
+        struct FrameUniforms {
+            glm::vec4 colorScale{1.0f};
+            glm::vec2 offset{0.0f};
+            float scale = 1.0f;
+            float time = 0.0f;
+        };
+
+        // push constants of triangle.vert: position * scale + offset and color * colorScale + colorBias, applied on
+        // top of the instance transform
+        struct ViewTransform {
+            glm::vec2 offset{0.0f};
+            float scale = 1.0f;
+            float colorScale = 1.0f;
+            glm::vec3 colorBias{0.0f};
+        };
+
+        struct DrawCommand {
+            uint32_t firstInstance;
+            uint32_t instanceCount;
+            ViewTransform view;
+        };
+
+        struct GeneratedModel {
+            Model::Builder builder;
+            int depth;
+            double generateMilliseconds;
+        };
+
+        // secondary command buffers per recording thread, so chunks stay small enough to be stolen
+        static constexpr uint32_t CHUNKS_PER_THREAD = 4;
+
+        // LOD levels kept besides the current one, so toggling between two extents does not regenerate
+        static constexpr size_t LOD_CACHE_SIZE = 2;
+
+        // with the camera, tiles are picked so that each covers TILE_PIXELS to twice that on screen
+        static constexpr double TILE_PIXELS = 256.0;
+        static constexpr int MAX_TILE_LEVEL = 48;
+        // zoom factor of one mouse wheel step
+        static constexpr double ZOOM_STEP = 1.25;
+
+        // uniform space of every frame slot, FrameUniforms is the only block written so far
+        static constexpr vk::DeviceSize FRAME_UNIFORM_BYTES = 16 * 1024;
+
         vk::UniquePipelineLayout createPipelineLayout();
 
-        std::unique_ptr<Pipeline> createPipeline();
+        // looks the pipeline up in the current registry, compiling it only the first time
+        Pipeline *createPipeline();
 
         std::vector<vk::UniqueCommandBuffer> createCommandBuffers();
 
-        std::unique_ptr<Model> loadModels();
+        void createFramePools();
+
+        std::unique_ptr<Model> loadModels(int depth);
+
+        // CPU side only, safe to run off the main thread
+        GeneratedModel generateModel(int depth) const;
+
+        std::unique_ptr<Model> uploadModel(GeneratedModel generated);
+
+        // Switches to the LOD level matching the on-screen size of a tile. Missing levels are generated in the
+        // background while the current one is kept, only the very first model is generated in place. Returns
+        // whether the model changed.
+        bool updateLod();
+
+        // applies mouse input and the zoom animation, returns whether the view moved
+        bool updateCamera();
+
+        // runs every frame: camera, LOD and, if either changed, the draw list
+        void updateView();
+
+        // on-screen pixels covered by the root triangle, the larger of its width and height
+        [[nodiscard]] double rootPixels() const;
+
+        // subdivision level of the tiles, 0 without the camera
+        [[nodiscard]] int tileLevel() const;
+
+        [[nodiscard]] ViewTransform tileView(const SierpinskiTile &tile) const;
+
+        void buildDrawList();
+
+        // slots of the per-frame rings: frames in flight, or swapchain images in the cached mode
+        [[nodiscard]] uint32_t frameSlotCount() const;
+
+        // writes this frame's uniforms into the slot, whose previous use must have completed
+        void updateFrameUniforms(uint32_t slot);
+
+        // animates the streaming model's vertices into the slot, whose previous use must have completed, growing the
+        // ring if the model outgrew it
+        void streamGeometry(uint32_t slot);
 
         void drawFrame();
 
         void recordCommandBuffer(vk::CommandBuffer cmd, uint32_t imageIndex);
 
-        Window window{WIDTH, HEIGHT, "first app"};
-        Device device{window};
+        // splits the draw list into chunks recorded into secondary command buffers by the job system, then
+        // executes them in draw list order; cmd must be inside a render pass begun for secondary buffers
+        void recordSecondaryCommandBuffers(vk::CommandBuffer cmd, uint32_t imageIndex);
+
+        // pipeline and dynamic state, secondary command buffers do not inherit them from the primary
+        void bindRenderState(vk::CommandBuffer cmd);
+
+        void recordDraws(vk::CommandBuffer cmd, size_t first, size_t last);
+
+        // forces every cached command buffer to be re-recorded before its next submission
+        void invalidateCommandBuffers();
+
+        // must run after acquireNextImage() has waited on the current frame slot's fence
+        void releaseRetired();
+
+        // Turns frames that are known to be displayed or complete into latency samples. Runs before
+        // acquireNextImage(), without present wait it waits on the current frame slot's fence itself.
+        void collectLatency();
+
+        void resize(vk::Extent2D extent);
+
+        std::chrono::steady_clock::time_point startupBegin = std::chrono::steady_clock::now();
+        AppConfig config;
+        std::unique_ptr<Window> window;
+        Device device{window.get(), config.pipelineCachePath};
         std::unique_ptr<SwapChain> swapchain;
-        std::unique_ptr<Pipeline> pipeline;
+        // pipelines for render passes compatible with the current swapchain's
+        std::unique_ptr<PipelineRegistry> pipelines;
+        Pipeline *pipeline = nullptr;
+        vk::UniqueDescriptorSetLayout frameSetLayout;
         vk::UniquePipelineLayout pipelineLayout;
+        // slots follow the frame in flight, or the image in the cached mode, like the profiler's query slots
+        std::unique_ptr<UniformRing> uniforms;
+        uint32_t frameUniformOffset = 0;
+        std::unique_ptr<StreamingBuffer> geometryStream;
+        // reused every frame, so streaming does not allocate
+        std::vector<Model::Vertex> streamedVertices;
+        // per-image buffers of the cached mode, individually resettable because only dirty ones are re-recorded
         std::vector<vk::UniqueCommandBuffer> commandBuffers;
+        // framePools[frame][thread], one pool per recording thread of every frame in flight, the primary buffer
+        // comes from thread 0's pool
+        std::vector<std::vector<std::unique_ptr<FrameCommandPool>>> framePools;
+        std::unique_ptr<JobSystem> jobs;
+        // fractal generation, used by one generation at a time: the first load, then pendingLod's task; declared
+        // before pendingLod so that task has finished before it is destroyed
+        std::unique_ptr<JobSystem> generateJobs;
+        std::vector<DrawCommand> drawList;
+        std::vector<vk::CommandBuffer> secondaryBuffers;
+        std::vector<bool> commandBufferDirty;
+        std::deque<RetiredFrameResources> retired;
+        uint64_t submittedFrames = 0;
+        uint32_t recreations = 0;
+        vk::Extent2D headlessExtent{config.width, config.height};
         std::unique_ptr<Model> model;
+        int modelDepth = 0;
+        // inactive LOD levels by depth
+        std::map<int, std::unique_ptr<Model>> lodModels;
+        std::future<GeneratedModel> pendingLod;
+        Camera camera;
+        std::unique_ptr<GpuFractal> gpuFractal;
+        // once a frame that records the generation has been submitted
+        bool gpuFractalGenerated = false;
+        std::unique_ptr<GpuProfiler> profiler;
+
+        std::vector<FrameStats> frames;
+        // when the events of the frame being drawn were polled
+        std::chrono::steady_clock::time_point inputTime;
+        struct PendingPresent {
+            uint64_t presentId;
+            std::chrono::steady_clock::time_point inputTime;
+        };
+        std::deque<PendingPresent> pendingPresents;
+        // without present wait: input time of the frame last submitted in each frame slot
+        std::vector<std::optional<std::chrono::steady_clock::time_point>> slotInputTimes;
+        std::vector<double> latencies;
+        LoadStats load{};
+        double lastRecordMilliseconds = 0.0;
 
-        std::unique_ptr<SwapChain> createSwapChain();
+        std::unique_ptr<SwapChain> createSwapChain(SwapChain *previous);
 
         void recreateSwapChain();
     };
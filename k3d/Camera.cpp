@@ -0,0 +1,20 @@
+#include "Camera.h"
+
+#include <algorithm>
+
+namespace k3d {
+    void Camera::pan(glm::dvec2 ndcDelta) {
+        center_ -= ndcDelta / zoom_;
+    }
+
+    void Camera::zoomAt(glm::dvec2 ndc, double factor) {
+        auto anchor = toWorld(ndc);
+        zoom_ = std::clamp(zoom_ * factor, 1.0 / 16.0, MAX_ZOOM);
+        center_ = anchor - ndc / zoom_;
+    }
+
+    void Camera::visibleBounds(glm::dvec2 &low, glm::dvec2 &high) const {
+        low = toWorld({-1.0, -1.0});
+        high = toWorld({1.0, 1.0});
+    }
+} // k3d
@@ -0,0 +1,42 @@
+#ifndef K3D_CAMERA_H
+#define K3D_CAMERA_H
+
+#define GLM_FORCE_RADIANS
+#define GLM_FORCE_DEPTH_ZERO_TO_ONE
+
+#include <glm/glm.hpp>
+
+namespace k3d {
+
+    // 2D pan and zoom view, normalized device coordinates are (world - center) * zoom. Kept in double so the
+    // transforms of deeply zoomed tiles can be made relative to the view before they are narrowed to float.
+    class Camera {
+    public:
+        // beyond this the spacing of doubles near the fractal approaches a pixel
+        static constexpr double MAX_ZOOM = 1e12;
+
+        [[nodiscard]] glm::dvec2 center() const { return center_; }
+
+        [[nodiscard]] double zoom() const { return zoom_; }
+
+        [[nodiscard]] glm::dvec2 toWorld(glm::dvec2 ndc) const { return center_ + ndc / zoom_; }
+
+        [[nodiscard]] glm::dvec2 toNdc(glm::dvec2 world) const { return (world - center_) * zoom_; }
+
+        // moves the view by a distance given in normalized device coordinates
+        void pan(glm::dvec2 ndcDelta);
+
+        // scales the zoom by factor while the world point under ndc stays in place
+        void zoomAt(glm::dvec2 ndc, double factor);
+
+        // world space rectangle covered by normalized device coordinates [-1, 1]^2
+        void visibleBounds(glm::dvec2 &low, glm::dvec2 &high) const;
+
+    private:
+        glm::dvec2 center_{0.0};
+        double zoom_ = 1.0;
+    };
+
+} // k3d
+
+#endif //K3D_CAMERA_H
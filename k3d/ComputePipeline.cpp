@@ -0,0 +1,48 @@
+#include "ComputePipeline.h"
+
+namespace k3d {
+    ComputePipeline::ComputePipeline(Device &device, std::span<const uint32_t> compCode,
+                                     vk::PipelineLayout pipelineLayout) : device(device) {
+        pipeline = createComputePipeline(compCode, pipelineLayout);
+    }
+
+    vk::UniquePipeline
+    ComputePipeline::createComputePipeline(std::span<const uint32_t> compCode, vk::PipelineLayout pipelineLayout) {
+        compShaderModule = createShaderModule(compCode);
+
+        vk::ComputePipelineCreateInfo pipelineCreateInfo{
+                .stage = {
+                        .stage = vk::ShaderStageFlagBits::eCompute,
+                        .module = compShaderModule.get(),
+                        .pName = "main",
+                },
+                .layout = pipelineLayout,
+                .basePipelineHandle = VK_NULL_HANDLE,
+                .basePipelineIndex = -1,
+        };
+
+        try {
+            return device.pipelineCache().createComputePipeline(pipelineCreateInfo);
+        } catch (const std::exception &e) {
+            throw std::runtime_error("failed to create compute pipeline");
+        }
+    }
+
+    vk::UniqueShaderModule ComputePipeline::createShaderModule(std::span<const uint32_t> code) {
+        vk::ShaderModuleCreateInfo createInfo{
+                .codeSize = code.size_bytes(),
+                .pCode = code.data(),
+        };
+        try {
+            return device.device().createShaderModuleUnique(createInfo);
+        } catch (const std::exception &e) {
+            throw std::runtime_error("unable to create shader module");
+        }
+    }
+
+    ComputePipeline::~ComputePipeline() = default;
+
+    void ComputePipeline::bind(vk::CommandBuffer commandBuffer) {
+        commandBuffer.bindPipeline(vk::PipelineBindPoint::eCompute, pipeline.get());
+    }
+} // k3d
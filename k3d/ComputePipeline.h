@@ -0,0 +1,33 @@
+#ifndef K3D_COMPUTEPIPELINE_H
+#define K3D_COMPUTEPIPELINE_H
+
+#include <span>
+#include "device.h"
+
+namespace k3d {
+
+    class ComputePipeline {
+    public:
+        ComputePipeline(Device &device, std::span<const uint32_t> compCode, vk::PipelineLayout pipelineLayout);
+
+        ~ ComputePipeline();
+
+        ComputePipeline(const ComputePipeline &) = delete;
+
+        ComputePipeline operator=(const ComputePipeline &) = delete;
+
+        void bind(vk::CommandBuffer commandBuffer);
+
+    private:
+        vk::UniquePipeline createComputePipeline(std::span<const uint32_t> compCode, vk::PipelineLayout pipelineLayout);
+
+        vk::UniqueShaderModule createShaderModule(std::span<const uint32_t> code);
+
+        Device &device;
+        vk::UniqueShaderModule compShaderModule;
+        vk::UniquePipeline pipeline;
+    };
+
+} // k3d
+
+#endif //K3D_COMPUTEPIPELINE_H
@@ -0,0 +1,179 @@
+#include "Fractal.h"
+#include "JobSystem.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace k3d {
+    namespace {
+        // below this many triangles per job splitting the work costs more than it saves
+        constexpr uint64_t MIN_TRIANGLES_PER_JOB = 16384;
+        // leaves are produced in subtrees of 3^SUBTREE_DEPTH triangles, only their roots are computed from the index
+        constexpr int SUBTREE_DEPTH = 6;
+        // 81 triangles, about 120 welded vertices, the smallest base mesh worth an instance
+        constexpr int MIN_BASE_DEPTH = 4;
+
+        // calls function(begin, end) on disjoint ranges covering [0, count), chunk bounds are multiples of grain;
+        // runs on the calling thread alone without jobs or when the work is too small to split
+        template<typename Function>
+        void parallelFor(JobSystem *jobs, uint64_t count, Function function, uint64_t grain = 1) {
+            uint64_t chunkCount = jobs == nullptr ? 1 : std::clamp<uint64_t>(count / MIN_TRIANGLES_PER_JOB, 1,
+                                                                             jobs->threadCount());
+            if (chunkCount == 1) {
+                function(0, count);
+                return;
+            }
+
+            uint64_t chunk = ((count + chunkCount - 1) / chunkCount + grain - 1) / grain * grain;
+            jobs->parallelFor(static_cast<uint32_t>((count + chunk - 1) / chunk), [&](uint32_t index, uint32_t) {
+                uint64_t begin = index * chunk;
+                function(begin, std::min(begin + chunk, count));
+            });
+        }
+    }
+
+    uint64_t sierpinskiTriangleCount(int depth) {
+        uint64_t count = 1;
+        for (int i = 0; i < depth; i++) {
+            count *= 3;
+        }
+        return count;
+    }
+
+    Triangle sierpinskiTriangle(const Triangle &root, int depth, uint64_t index) {
+        Triangle t = root;
+        uint64_t divisor = sierpinskiTriangleCount(depth) / 3;
+        for (int level = 0; level < depth; level++, divisor /= 3) {
+            auto m12 = (t.v1 + t.v2) / 2.0f;
+            auto m13 = (t.v1 + t.v3) / 2.0f;
+            auto m23 = (t.v2 + t.v3) / 2.0f;
+            switch ((index / divisor) % 3) {
+                case 0:
+                    t = {t.v1, m12, m13};
+                    break;
+                case 1:
+                    t = {t.v2, m12, m23};
+                    break;
+                default:
+                    t = {t.v3, m23, m13};
+                    break;
+            }
+        }
+        return t;
+    }
+
+    std::vector<Model::Vertex> sierpinski(glm::vec2 v1, glm::vec2 v2, glm::vec2 v3, int depth, JobSystem *jobs) {
+        assert(depth >= 0 && "depth must not be negative");
+        int subtreeDepth = std::min(depth, SUBTREE_DEPTH);
+        uint64_t subtreeCount = sierpinskiTriangleCount(depth - subtreeDepth);
+        uint64_t subtreeSize = sierpinskiTriangleCount(subtreeDepth);
+        std::vector<Model::Vertex> vertices(subtreeCount * subtreeSize * 3);
+
+        auto expand = [](auto &self, const Triangle &t, int levels, Model::Vertex *&out) -> void {
+            if (levels == 0) {
+                *out++ = {t.v1, sierpinskiColor(t.v1)};
+                *out++ = {t.v2, sierpinskiColor(t.v2)};
+                *out++ = {t.v3, sierpinskiColor(t.v3)};
+                return;
+            }
+            auto m12 = (t.v1 + t.v2) / 2.0f;
+            auto m13 = (t.v1 + t.v3) / 2.0f;
+            auto m23 = (t.v2 + t.v3) / 2.0f;
+            self(self, {t.v1, m12, m13}, levels - 1, out);
+            self(self, {t.v2, m12, m23}, levels - 1, out);
+            self(self, {t.v3, m23, m13}, levels - 1, out);
+        };
+
+        Triangle root{v1, v2, v3};
+        parallelFor(jobs, subtreeCount * subtreeSize, [&, subtreeDepth](uint64_t begin, uint64_t end) {
+            // chunks are split at subtree granularity below
+            for (uint64_t subtree = begin / subtreeSize; subtree < end / subtreeSize; subtree++) {
+                Model::Vertex *out = vertices.data() + subtree * subtreeSize * 3;
+                expand(expand, sierpinskiTriangle(root, depth - subtreeDepth, subtree), subtreeDepth, out);
+            }
+        }, subtreeSize);
+        return vertices;
+    }
+
+    glm::vec3 sierpinskiColor(glm::vec2 position) {
+        return {(position.x + 1) / 2, (position.y + 1) / 2, (position.x + position.y + 2) / 4};
+    }
+
+    int sierpinskiLodDepth(double rootPixels, double targetPixels, int maxDepth) {
+        auto depth = static_cast<int>(std::ceil(std::log2(rootPixels / targetPixels)));
+        return std::clamp(depth, 1, std::max(maxDepth, 1));
+    }
+
+    int sierpinskiBaseDepth(int depth, size_t vertexSize) {
+        auto cost = [depth, vertexSize](int baseDepth) {
+            uint64_t triangles = sierpinskiTriangleCount(baseDepth);
+            // a welded depth k sierpinski has (3^(k+1) + 3) / 2 distinct corners
+            uint64_t vertices = (3 * triangles + 3) / 2;
+            return vertices * vertexSize + 3 * triangles * sizeof(uint32_t) +
+                   sierpinskiTriangleCount(depth - baseDepth) * sizeof(Model::Instance);
+        };
+        int best = std::min(depth, MIN_BASE_DEPTH);
+        for (int baseDepth = best + 1; baseDepth <= depth; baseDepth++) {
+            if (cost(baseDepth) < cost(best)) {
+                best = baseDepth;
+            }
+        }
+        return best;
+    }
+
+    std::vector<SierpinskiTile> sierpinskiVisibleTiles(glm::dvec2 v1, glm::dvec2 v2, glm::dvec2 v3, int level,
+                                                       glm::dvec2 low, glm::dvec2 high) {
+        glm::dvec2 rootLow = glm::min(v1, glm::min(v2, v3));
+        glm::dvec2 rootHigh = glm::max(v1, glm::max(v2, v3));
+        std::vector<SierpinskiTile> visible;
+        std::vector<std::pair<SierpinskiTile, int>> stack{{{.offset = glm::dvec2{0.0}, .scale = 1.0}, 0}};
+        while (!stack.empty()) {
+            auto [tile, tileLevel] = stack.back();
+            stack.pop_back();
+            glm::dvec2 tileLow = tile.offset + rootLow * tile.scale;
+            glm::dvec2 tileHigh = tile.offset + rootHigh * tile.scale;
+            if (tileHigh.x < low.x || tileHigh.y < low.y || tileLow.x > high.x || tileLow.y > high.y) {
+                continue;
+            }
+            if (tileLevel == level) {
+                visible.push_back(tile);
+                continue;
+            }
+            // the corner child towards v keeps v and halves the triangle
+            for (auto corner: {v1, v2, v3}) {
+                stack.push_back({{.offset = tile.offset + corner * (tile.scale / 2.0), .scale = tile.scale / 2.0},
+                                 tileLevel + 1});
+            }
+        }
+        return visible;
+    }
+
+    Model::Builder sierpinskiInstanced(glm::vec2 v1, glm::vec2 v2, glm::vec2 v3, int depth, int baseDepth,
+                                       JobSystem *jobs) {
+        assert(baseDepth >= 0 && baseDepth <= depth && "base depth must lie within depth");
+        Model::Builder builder{.vertices = sierpinski(v1, v2, v3, baseDepth, jobs)};
+
+        Triangle root{v1, v2, v3};
+        glm::vec2 rootCentroid = (v1 + v2 + v3) / 3.0f;
+        int instanceDepth = depth - baseDepth;
+        float scale = std::ldexp(1.0f, -instanceDepth);
+        // sierpinskiColor is affine, so color(scale * p + offset) = scale * color(p) + color(offset) - scale * color(0)
+        glm::vec3 colorOrigin = sierpinskiColor({0.0f, 0.0f});
+
+        builder.instances.resize(sierpinskiTriangleCount(instanceDepth));
+        parallelFor(jobs, builder.instances.size(), [&](uint64_t begin, uint64_t end) {
+            for (uint64_t i = begin; i < end; i++) {
+                // leaves may list their corners rotated against the root, but a subdivision does not depend on
+                // the corner order, so mapping centroid to centroid is enough
+                Triangle leaf = sierpinskiTriangle(root, instanceDepth, i);
+                glm::vec2 offset = (leaf.v1 + leaf.v2 + leaf.v3) / 3.0f - rootCentroid * scale;
+                builder.instances[i] = {
+                        .offset = offset,
+                        .scale = scale,
+                        .colorBias = sierpinskiColor(offset) - colorOrigin * scale,
+                };
+            }
+        });
+        return builder;
+    }
+} // k3d
@@ -0,0 +1,58 @@
+#ifndef K3D_FRACTAL_H
+#define K3D_FRACTAL_H
+
+#include "Model.h"
+
+#include <cstdint>
+#include <vector>
+
+namespace k3d {
+
+    class JobSystem;
+
+    struct Triangle {
+        glm::vec2 v1, v2, v3;
+    };
+
+    // A sub-triangle of the root as a placement of the root, corner p of the root maps to p * scale + offset.
+    struct SierpinskiTile {
+        glm::dvec2 offset;
+        double scale;
+    };
+
+    // number of leaf triangles of a sierpinski triangle of the given depth, 3^depth
+    uint64_t sierpinskiTriangleCount(int depth);
+
+    // Leaf triangle `index` of the subdivision of `root`. The base 3 digits of index, most significant first,
+    // select the corner sub-triangle taken at every level.
+    Triangle sierpinskiTriangle(const Triangle &root, int depth, uint64_t index);
+
+    // Builds all 3^depth leaf triangles into an exactly sized buffer, split across the threads of jobs if given.
+    std::vector<Model::Vertex> sierpinski(glm::vec2 v1, glm::vec2 v2, glm::vec2 v3, int depth,
+                                          JobSystem *jobs = nullptr);
+
+    glm::vec3 sierpinskiColor(glm::vec2 position);
+
+    // Depth of the base mesh sierpinskiInstanced() replicates for a fractal of the given depth. Minimizes the bytes
+    // of welded base mesh plus instance data, but keeps the base large enough that an instance fills a few waves.
+    // vertexSize is the bytes per vertex of the layout the mesh is uploaded in.
+    int sierpinskiBaseDepth(int depth, size_t vertexSize = sizeof(Model::Vertex));
+
+    // Smallest depth, clamped to [1, maxDepth], at which the leaves of a root triangle rootPixels across on screen
+    // are at most targetPixels across. Every level halves the leaf size.
+    int sierpinskiLodDepth(double rootPixels, double targetPixels, int maxDepth);
+
+    // Sub-triangles `level` subdivisions below the root whose bounding box intersects [low, high]. Only intersecting
+    // triangles are descended into, so the cost follows the number of visible tiles instead of 3^level.
+    std::vector<SierpinskiTile> sierpinskiVisibleTiles(glm::dvec2 v1, glm::dvec2 v2, glm::dvec2 v3, int level,
+                                                       glm::dvec2 low, glm::dvec2 high);
+
+    // The depth `depth` sierpinski triangle as a depth `baseDepth` mesh of the root, drawn once for every leaf of the
+    // remaining depth - baseDepth levels. Every leaf is the root scaled by 2^-(depth - baseDepth), so one uniform
+    // scale and an offset place each copy.
+    Model::Builder sierpinskiInstanced(glm::vec2 v1, glm::vec2 v2, glm::vec2 v3, int depth, int baseDepth,
+                                       JobSystem *jobs = nullptr);
+
+} // k3d
+
+#endif //K3D_FRACTAL_H
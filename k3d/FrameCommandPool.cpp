@@ -0,0 +1,40 @@
+#include "FrameCommandPool.h"
+
+namespace k3d {
+    FrameCommandPool::FrameCommandPool(Device &device, uint32_t queueFamilyIndex) : device{device} {
+        vk::CommandPoolCreateInfo poolInfo{
+                .flags = vk::CommandPoolCreateFlagBits::eTransient,
+                .queueFamilyIndex = queueFamilyIndex,
+        };
+        try {
+            commandPool = device.device().createCommandPoolUnique(poolInfo);
+        } catch (const std::exception &) {
+            throw std::runtime_error("failed to create frame command pool");
+        }
+    }
+
+    FrameCommandPool::~FrameCommandPool() = default;
+
+    void FrameCommandPool::reset() {
+        device.device().resetCommandPool(commandPool.get());
+        primary.used = 0;
+        secondary.used = 0;
+    }
+
+    vk::CommandBuffer FrameCommandPool::allocate(vk::CommandBufferLevel level) {
+        auto &buffers = level == vk::CommandBufferLevel::ePrimary ? primary : secondary;
+        if (buffers.used == buffers.allocated.size()) {
+            vk::CommandBufferAllocateInfo allocateInfo{
+                    .commandPool = commandPool.get(),
+                    .level = level,
+                    .commandBufferCount = 1,
+            };
+            try {
+                buffers.allocated.push_back(device.device().allocateCommandBuffers(allocateInfo).front());
+            } catch (const std::exception &) {
+                throw std::runtime_error("failed to allocate command buffers");
+            }
+        }
+        return buffers.allocated[buffers.used++];
+    }
+} // k3d
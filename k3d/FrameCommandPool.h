@@ -0,0 +1,42 @@
+#ifndef K3D_FRAMECOMMANDPOOL_H
+#define K3D_FRAMECOMMANDPOOL_H
+
+#include "device.h"
+
+#include <vector>
+
+namespace k3d {
+
+    // Command buffers of one frame in flight. They come from a transient pool of their own that is reset in a
+    // single call once the frame slot's fence has signaled, instead of resetting every buffer individually.
+    class FrameCommandPool {
+    public:
+        FrameCommandPool(Device &device, uint32_t queueFamilyIndex);
+
+        ~FrameCommandPool();
+
+        FrameCommandPool(const FrameCommandPool &) = delete;
+
+        FrameCommandPool &operator=(const FrameCommandPool &) = delete;
+
+        // recycles every buffer handed out since the last reset, none of them may be pending
+        void reset();
+
+        // a buffer in the initial state, reused from before the last reset when possible
+        vk::CommandBuffer allocate(vk::CommandBufferLevel level = vk::CommandBufferLevel::ePrimary);
+
+    private:
+        struct Buffers {
+            std::vector<vk::CommandBuffer> allocated;
+            size_t used = 0;
+        };
+
+        Device &device;
+        vk::UniqueCommandPool commandPool;
+        Buffers primary;
+        Buffers secondary;
+    };
+
+} // k3d
+
+#endif //K3D_FRAMECOMMANDPOOL_H
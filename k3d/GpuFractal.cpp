@@ -0,0 +1,196 @@
+#include "GpuFractal.h"
+#include "Model.h"
+#include "ShaderCode.h"
+#include "shaders/fractal.comp.h"
+
+#include <algorithm>
+#include <array>
+#include <limits>
+
+namespace k3d {
+    GpuFractal::GpuFractal(Device &device, FractalKind kind, int depth) : device{device}, kind{kind}, depth{depth} {
+        if (primitiveCount(kind, depth) * verticesPerPrimitive(kind) > std::numeric_limits<uint32_t>::max()) {
+            throw std::runtime_error("fractal depth too large for a single draw");
+        }
+        createBuffers();
+        createDescriptors();
+        createPipelineLayout();
+        pipeline = std::make_unique<ComputePipeline>(
+                device, ShaderCode{"fractal.comp.spv", shaders::fractal_comp}.code(), pipelineLayout.get());
+    }
+
+    GpuFractal::~GpuFractal() = default;
+
+    uint64_t GpuFractal::primitiveCount(FractalKind kind, int depth) {
+        uint64_t base = kind == FractalKind::Sierpinski ? 3 : 4;
+        base = kind == FractalKind::Carpet ? 8 : base;
+        uint64_t count = kind == FractalKind::Koch ? 3 : 1;
+        for (int i = 0; i < depth; i++) {
+            count *= base;
+        }
+        return count;
+    }
+
+    uint32_t GpuFractal::verticesPerPrimitive(FractalKind kind) {
+        return kind == FractalKind::Carpet ? 6 : 3;
+    }
+
+    void GpuFractal::createBuffers() {
+        vk::DeviceSize vertexBufferSize = vertexCount() * sizeof(Model::Vertex);
+        vk::DeviceSize primitiveBytes = verticesPerPrimitive(kind) * sizeof(Model::Vertex);
+        // a multiple of the offset alignment in primitives keeps the byte offset of every window aligned
+        vk::DeviceSize alignment = std::max<vk::DeviceSize>(
+                device.properties.limits.minStorageBufferOffsetAlignment, 1);
+        windowPrimitives = static_cast<uint32_t>(std::min<vk::DeviceSize>(
+                primitiveCount(kind, depth),
+                device.properties.limits.maxStorageBufferRange / primitiveBytes / alignment * alignment));
+        if (windowPrimitives == 0) {
+            throw std::runtime_error("maxStorageBufferRange too small for a fractal primitive");
+        }
+        device.createBuffer(vertexBufferSize,
+                            vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eVertexBuffer,
+                            vk::MemoryPropertyFlagBits::eDeviceLocal,
+                            vertexBuffer, vertexMemory);
+        device.createBuffer(sizeof(vk::DrawIndirectCommand),
+                            vk::BufferUsageFlagBits::eStorageBuffer | vk::BufferUsageFlagBits::eIndirectBuffer,
+                            vk::MemoryPropertyFlagBits::eDeviceLocal,
+                            indirectBuffer, indirectMemory);
+        device.createBuffer(sizeof(Model::Instance),
+                            vk::BufferUsageFlagBits::eVertexBuffer,
+                            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                            instanceBuffer, instanceMemory);
+        *static_cast<Model::Instance *>(instanceMemory.mapped()) = Model::Instance{};
+    }
+
+    void GpuFractal::createDescriptors() {
+        std::array<vk::DescriptorSetLayoutBinding, 2> bindings{};
+        for (uint32_t i = 0; i < bindings.size(); i++) {
+            bindings[i] = {
+                    .binding = i,
+                    .descriptorType = vk::DescriptorType::eStorageBuffer,
+                    .descriptorCount = 1,
+                    .stageFlags = vk::ShaderStageFlagBits::eCompute,
+            };
+        }
+        vk::DescriptorSetLayoutCreateInfo layoutInfo{
+                .bindingCount = static_cast<uint32_t>(bindings.size()),
+                .pBindings = bindings.data(),
+        };
+        auto count = primitiveCount(kind, depth);
+        auto windowCount = static_cast<uint32_t>((count + windowPrimitives - 1) / windowPrimitives);
+        vk::DescriptorPoolSize poolSize{
+                .type = vk::DescriptorType::eStorageBuffer,
+                .descriptorCount = static_cast<uint32_t>(bindings.size()) * windowCount,
+        };
+        vk::DescriptorPoolCreateInfo poolInfo{
+                .maxSets = windowCount,
+                .poolSizeCount = 1,
+                .pPoolSizes = &poolSize,
+        };
+        try {
+            descriptorSetLayout = device.device().createDescriptorSetLayoutUnique(layoutInfo);
+            descriptorPool = device.device().createDescriptorPoolUnique(poolInfo);
+            std::vector<vk::DescriptorSetLayout> setLayouts(windowCount, descriptorSetLayout.get());
+            vk::DescriptorSetAllocateInfo allocateInfo{
+                    .descriptorPool = descriptorPool.get(),
+                    .descriptorSetCount = windowCount,
+                    .pSetLayouts = setLayouts.data(),
+            };
+            descriptorSets = device.device().allocateDescriptorSets(allocateInfo);
+        } catch (const std::exception &) {
+            throw std::runtime_error("failed to create fractal descriptor set");
+        }
+
+        vk::DeviceSize primitiveBytes = verticesPerPrimitive(kind) * sizeof(Model::Vertex);
+        for (uint32_t window = 0; window < windowCount; window++) {
+            uint64_t windowBase = static_cast<uint64_t>(window) * windowPrimitives;
+            std::array<vk::DescriptorBufferInfo, 2> bufferInfos{
+                    vk::DescriptorBufferInfo{
+                            .buffer = vertexBuffer.get(),
+                            .offset = windowBase * primitiveBytes,
+                            .range = std::min<uint64_t>(windowPrimitives, count - windowBase) * primitiveBytes,
+                    },
+                    vk::DescriptorBufferInfo{.buffer = indirectBuffer.get(), .offset = 0, .range = VK_WHOLE_SIZE},
+            };
+            std::array<vk::WriteDescriptorSet, 2> writes{};
+            for (uint32_t i = 0; i < writes.size(); i++) {
+                writes[i] = {
+                        .dstSet = descriptorSets[window],
+                        .dstBinding = i,
+                        .descriptorCount = 1,
+                        .descriptorType = vk::DescriptorType::eStorageBuffer,
+                        .pBufferInfo = &bufferInfos[i],
+                };
+            }
+            device.device().updateDescriptorSets(writes, {});
+        }
+    }
+
+    void GpuFractal::createPipelineLayout() {
+        vk::PushConstantRange pushConstantRange{
+                .stageFlags = vk::ShaderStageFlagBits::eCompute,
+                .offset = 0,
+                .size = sizeof(Push),
+        };
+        vk::PipelineLayoutCreateInfo layout{
+                .setLayoutCount = 1,
+                .pSetLayouts = &descriptorSetLayout.get(),
+                .pushConstantRangeCount = 1,
+                .pPushConstantRanges = &pushConstantRange,
+        };
+        try {
+            pipelineLayout = device.device().createPipelineLayoutUnique(layout);
+        } catch (const std::exception &) {
+            throw std::runtime_error("failed to create compute pipeline layout");
+        }
+    }
+
+    void GpuFractal::recordGenerate(vk::CommandBuffer commandBuffer) {
+        auto count = static_cast<uint32_t>(primitiveCount(kind, depth));
+        // large fractals exceed maxComputeWorkGroupCount, so they are generated in several dispatches
+        uint32_t maxGroups = device.properties.limits.maxComputeWorkGroupCount[0];
+
+        pipeline->bind(commandBuffer);
+        for (uint32_t window = 0; window < descriptorSets.size(); window++) {
+            uint32_t windowBase = window * windowPrimitives;
+            uint32_t windowEnd = windowBase + std::min(windowPrimitives, count - windowBase);
+            commandBuffer.bindDescriptorSets(vk::PipelineBindPoint::eCompute, pipelineLayout.get(), 0,
+                                             descriptorSets[window], {});
+            uint32_t baseIndex = windowBase;
+            do {
+                uint32_t remaining = windowEnd - baseIndex;
+                uint32_t groups = std::min(maxGroups, (remaining + WORKGROUP_SIZE - 1) / WORKGROUP_SIZE);
+                Push push{
+                        .kind = static_cast<uint32_t>(kind),
+                        .depth = static_cast<uint32_t>(depth),
+                        .baseIndex = baseIndex,
+                        .primitiveCount = count,
+                        .windowBase = windowBase,
+                        .windowEnd = windowEnd,
+                };
+                commandBuffer.pushConstants(pipelineLayout.get(), vk::ShaderStageFlagBits::eCompute, 0,
+                                            sizeof(Push), &push);
+                commandBuffer.dispatch(groups, 1, 1);
+                baseIndex += std::min(remaining, groups * WORKGROUP_SIZE);
+            } while (baseIndex < windowEnd);
+        }
+
+        vk::MemoryBarrier barrier{
+                .srcAccessMask = vk::AccessFlagBits::eShaderWrite,
+                .dstAccessMask = vk::AccessFlagBits::eVertexAttributeRead | vk::AccessFlagBits::eIndirectCommandRead,
+        };
+        commandBuffer.pipelineBarrier(vk::PipelineStageFlagBits::eComputeShader,
+                                      vk::PipelineStageFlagBits::eVertexInput | vk::PipelineStageFlagBits::eDrawIndirect,
+                                      {}, barrier, {}, {});
+    }
+
+    void GpuFractal::bind(vk::CommandBuffer commandBuffer) {
+        std::array<vk::Buffer, 2> buffers{vertexBuffer.get(), instanceBuffer.get()};
+        std::array<vk::DeviceSize, 2> offsets{0, 0};
+        commandBuffer.bindVertexBuffers(0, buffers, offsets);
+    }
+
+    void GpuFractal::draw(vk::CommandBuffer commandBuffer) const {
+        commandBuffer.drawIndirect(indirectBuffer.get(), 0, 1, sizeof(vk::DrawIndirectCommand));
+    }
+} // k3d
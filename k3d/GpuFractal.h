@@ -0,0 +1,90 @@
+#ifndef K3D_GPUFRACTAL_H
+#define K3D_GPUFRACTAL_H
+
+#include "ComputePipeline.h"
+#include "device.h"
+
+#include <memory>
+#include <vector>
+
+namespace k3d {
+
+    enum class FractalKind : uint32_t {
+        Sierpinski = 0,
+        // sierpinski carpet, two triangles per remaining square
+        Carpet = 1,
+        // filled koch snowflake, one triangle from the center to every curve segment
+        Koch = 2,
+    };
+
+    // Generates a subdivision fractal with a compute shader straight into a device local vertex buffer, together
+    // with the indirect draw command that renders it. The vertex data never exists in host memory. Generation is
+    // recorded into a command buffer of the caller's, nothing is submitted here.
+    class GpuFractal {
+    public:
+        GpuFractal(Device &device, FractalKind kind, int depth);
+
+        ~ GpuFractal();
+
+        GpuFractal(const GpuFractal &) = delete;
+
+        GpuFractal operator=(const GpuFractal &) = delete;
+
+        // Records the dispatches that fill the vertex and indirect buffers, and the barrier that makes them
+        // visible to vertex input and indirect draws. It must be submitted once, on a queue that supports compute,
+        // before or in the same command buffer as the first draw.
+        void recordGenerate(vk::CommandBuffer commandBuffer);
+
+        void bind(vk::CommandBuffer commandBuffer);
+
+        void draw(vk::CommandBuffer commandBuffer) const;
+
+        [[nodiscard]] uint64_t vertexCount() const { return primitiveCount(kind, depth) * verticesPerPrimitive(kind); }
+
+        static uint64_t primitiveCount(FractalKind kind, int depth);
+
+        static uint32_t verticesPerPrimitive(FractalKind kind);
+
+    private:
+        struct Push {
+            uint32_t kind;
+            uint32_t depth;
+            uint32_t baseIndex;
+            uint32_t primitiveCount;
+            uint32_t windowBase;
+            uint32_t windowEnd;
+        };
+
+        static constexpr uint32_t WORKGROUP_SIZE = 64;
+
+        void createBuffers();
+
+        void createDescriptors();
+
+        void createPipelineLayout();
+
+        Device &device;
+        FractalKind kind;
+        int depth;
+
+        vk::UniqueBuffer vertexBuffer;
+        Allocation vertexMemory;
+        vk::UniqueBuffer indirectBuffer;
+        Allocation indirectMemory;
+        // a single identity Model::Instance for the graphics pipeline's instance binding
+        vk::UniqueBuffer instanceBuffer;
+        Allocation instanceMemory;
+
+        vk::UniqueDescriptorSetLayout descriptorSetLayout;
+        vk::UniqueDescriptorPool descriptorPool;
+        // Primitives per descriptor set. A storage buffer binding may not exceed maxStorageBufferRange, so larger
+        // vertex buffers are written through several windows, one set each.
+        uint32_t windowPrimitives = 0;
+        std::vector<vk::DescriptorSet> descriptorSets;
+        vk::UniquePipelineLayout pipelineLayout;
+        std::unique_ptr<ComputePipeline> pipeline;
+    };
+
+} // k3d
+
+#endif //K3D_GPUFRACTAL_H
@@ -0,0 +1,142 @@
+#include "GpuProfiler.h"
+
+#include <cassert>
+#include <iostream>
+#include <numeric>
+
+namespace k3d {
+    GpuProfiler::GpuProfiler(Device &device, uint32_t slotCount, uint32_t logInterval)
+            : device{device}, logInterval{logInterval} {
+        uint32_t validBits = device.timestampValidBits();
+        supported = validBits != 0 && device.properties.limits.timestampPeriod > 0.0f;
+        timestampMask = validBits >= 64 ? ~uint64_t{0} : (uint64_t{1} << validBits) - 1;
+        nanosecondsPerTick = device.properties.limits.timestampPeriod;
+        if (!supported) {
+            std::cerr << "gpu profiler: timestamps are not supported on the graphics queue" << std::endl;
+            return;
+        }
+
+        ensureSlots(slotCount);
+    }
+
+    void GpuProfiler::ensureSlots(uint32_t slotCount) {
+        if (!supported || slotCount <= slots.size()) {
+            return;
+        }
+        recording = nullptr;
+        auto first = slots.size();
+        slots.resize(slotCount);
+        for (auto i = first; i < slots.size(); i++) {
+            createQueryPool(slots[i]);
+        }
+    }
+
+    void GpuProfiler::createQueryPool(Slot &slot) {
+        vk::QueryPoolCreateInfo createInfo{
+                .queryType = vk::QueryType::eTimestamp,
+                .queryCount = MAX_PASSES * 2,
+        };
+        try {
+            slot.queryPool = device.device().createQueryPoolUnique(createInfo);
+        } catch (const std::exception &) {
+            throw std::runtime_error("failed to create timestamp query pool");
+        }
+    }
+
+    GpuProfiler::~GpuProfiler() = default;
+
+    void GpuProfiler::beginFrame(vk::CommandBuffer commandBuffer, uint32_t slot) {
+        if (!supported) {
+            return;
+        }
+        assert(slot < slots.size() && "profiler slot out of range");
+        recording = &slots[slot];
+        collect(*recording);
+        commandBuffer.resetQueryPool(recording->queryPool.get(), 0, MAX_PASSES * 2);
+        recording->passNames.clear();
+        recording->pending = true;
+        openPasses.clear();
+    }
+
+    void GpuProfiler::beginPass(vk::CommandBuffer commandBuffer, const std::string &name) {
+        if (!supported || recording == nullptr || recording->passNames.size() >= MAX_PASSES) {
+            return;
+        }
+        auto pass = static_cast<uint32_t>(recording->passNames.size());
+        recording->passNames.push_back(name);
+        openPasses.push_back(pass);
+        commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eTopOfPipe, recording->queryPool.get(), pass * 2);
+    }
+
+    void GpuProfiler::endPass(vk::CommandBuffer commandBuffer) {
+        if (!supported || recording == nullptr || openPasses.empty()) {
+            return;
+        }
+        auto pass = openPasses.back();
+        openPasses.pop_back();
+        commandBuffer.writeTimestamp(vk::PipelineStageFlagBits::eBottomOfPipe, recording->queryPool.get(),
+                                     pass * 2 + 1);
+    }
+
+    void GpuProfiler::collect(uint32_t slot) {
+        if (supported && slot < slots.size()) {
+            collect(slots[slot]);
+        }
+    }
+
+    void GpuProfiler::resubmit(uint32_t slot) {
+        if (supported && slot < slots.size()) {
+            slots[slot].pending = true;
+        }
+    }
+
+    void GpuProfiler::collect(Slot &slot) {
+        if (!slot.pending || slot.passNames.empty()) {
+            return;
+        }
+
+        auto queryCount = static_cast<uint32_t>(slot.passNames.size() * 2);
+        auto results = device.device().getQueryPoolResults<uint64_t>(
+                slot.queryPool.get(), 0, queryCount, queryCount * sizeof(uint64_t), sizeof(uint64_t),
+                vk::QueryResultFlagBits::e64);
+        if (results.result != vk::Result::eSuccess) {
+            return;
+        }
+        slot.pending = false;
+
+        latest.clear();
+        for (size_t pass = 0; pass < slot.passNames.size(); pass++) {
+            uint64_t ticks = (results.value[pass * 2 + 1] - results.value[pass * 2]) & timestampMask;
+            double milliseconds = static_cast<double>(ticks) * nanosecondsPerTick / 1e6;
+            latest.push_back({slot.passNames[pass], milliseconds});
+
+            auto &samples = passHistory[slot.passNames[pass]];
+            samples.push_back(milliseconds);
+            if (samples.size() > HISTORY_LENGTH) {
+                samples.pop_front();
+            }
+        }
+
+        collectedFrames++;
+        if (logInterval != 0 && collectedFrames % logInterval == 0) {
+            log();
+        }
+    }
+
+    double GpuProfiler::averageMilliseconds(const std::string &name) const {
+        auto it = passHistory.find(name);
+        if (it == passHistory.end() || it->second.empty()) {
+            return 0.0;
+        }
+        return std::accumulate(it->second.begin(), it->second.end(), 0.0) /
+               static_cast<double>(it->second.size());
+    }
+
+    void GpuProfiler::log() const {
+        std::cerr << "gpu:";
+        for (const auto &[name, samples]: passHistory) {
+            std::cerr << " " << name << " " << averageMilliseconds(name) << "ms";
+        }
+        std::cerr << " (rolling average)" << std::endl;
+    }
+} // k3d
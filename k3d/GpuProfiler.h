@@ -0,0 +1,91 @@
+#ifndef K3D_GPUPROFILER_H
+#define K3D_GPUPROFILER_H
+
+#include "device.h"
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+namespace k3d {
+
+    // Brackets passes with timestamp queries. Every slot owns a query pool, slots map to frames in flight so
+    // a slot's results are read back only after its fence has signaled, one frame-in-flight late, and never stall.
+    class GpuProfiler {
+    public:
+        struct PassTiming {
+            std::string name;
+            double milliseconds;
+        };
+
+        static constexpr uint32_t MAX_PASSES = 16;
+        static constexpr size_t HISTORY_LENGTH = 240;
+
+        // logInterval is the number of read back frames between rolling log lines, 0 disables logging
+        GpuProfiler(Device &device, uint32_t slotCount, uint32_t logInterval = 0);
+
+        ~GpuProfiler();
+
+        GpuProfiler(const GpuProfiler &) = delete;
+
+        GpuProfiler operator=(const GpuProfiler &) = delete;
+
+        [[nodiscard]] bool isSupported() const { return supported; }
+
+        // Reads back what the slot recorded last time, then resets its queries. Must be recorded outside of a
+        // render pass, after the fence guarding the slot's previous submission has been waited on.
+        void beginFrame(vk::CommandBuffer commandBuffer, uint32_t slot);
+
+        void beginPass(vk::CommandBuffer commandBuffer, const std::string &name);
+
+        void endPass(vk::CommandBuffer commandBuffer);
+
+        // Reads back the slot's results if they are available, without waiting. Used for command buffers that
+        // are recorded once and submitted many times, followed by resubmit() once the slot is submitted again.
+        void collect(uint32_t slot);
+
+        void resubmit(uint32_t slot);
+
+        // grows the number of slots, existing slots and their pending queries are kept
+        void ensureSlots(uint32_t slotCount);
+
+        // pass timings of the most recent frame that has been read back
+        [[nodiscard]] const std::vector<PassTiming> &lastFrame() const { return latest; }
+
+        // mean over the last HISTORY_LENGTH read back frames, 0 if the pass was never seen
+        [[nodiscard]] double averageMilliseconds(const std::string &name) const;
+
+        [[nodiscard]] const std::map<std::string, std::deque<double>> &history() const { return passHistory; }
+
+    private:
+        struct Slot {
+            vk::UniqueQueryPool queryPool;
+            std::vector<std::string> passNames;
+            bool pending = false;
+        };
+
+        void collect(Slot &slot);
+
+        void createQueryPool(Slot &slot);
+
+        void log() const;
+
+        Device &device;
+        bool supported;
+        uint64_t timestampMask = 0;
+        double nanosecondsPerTick;
+        uint32_t logInterval;
+        uint64_t collectedFrames = 0;
+
+        std::vector<Slot> slots;
+        Slot *recording = nullptr;
+        std::vector<uint32_t> openPasses;
+
+        std::vector<PassTiming> latest;
+        std::map<std::string, std::deque<double>> passHistory;
+    };
+
+} // k3d
+
+#endif //K3D_GPUPROFILER_H
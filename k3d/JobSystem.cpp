@@ -0,0 +1,103 @@
+#include "JobSystem.h"
+
+namespace k3d {
+    JobSystem::JobSystem(uint32_t workerCount) {
+        for (uint32_t i = 0; i <= workerCount; i++) {
+            queues.push_back(std::make_unique<Queue>());
+        }
+        for (uint32_t i = 1; i <= workerCount; i++) {
+            workers.emplace_back(&JobSystem::workerLoop, this, i);
+        }
+    }
+
+    JobSystem::~JobSystem() {
+        {
+            std::lock_guard lock{wakeMutex};
+            stopping = true;
+        }
+        wake.notify_all();
+        for (auto &worker: workers) {
+            worker.join();
+        }
+    }
+
+    void JobSystem::parallelFor(uint32_t count,
+                                const std::function<void(uint32_t index, uint32_t thread)> &function) {
+        if (count == 0) {
+            return;
+        }
+        std::atomic<uint32_t> remaining{count};
+        std::exception_ptr error;
+        std::mutex errorMutex;
+
+        for (uint32_t index = 0; index < count; index++) {
+            auto &queue = *queues[index % queues.size()];
+            std::lock_guard lock{queue.mutex};
+            queue.jobs.emplace_back([&, index](uint32_t thread) {
+                try {
+                    function(index, thread);
+                } catch (...) {
+                    std::lock_guard errorLock{errorMutex};
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                }
+                remaining.fetch_sub(1, std::memory_order_release);
+            });
+        }
+        {
+            std::lock_guard lock{wakeMutex};
+            queuedJobs += count;
+        }
+        wake.notify_all();
+
+        // help out instead of blocking, then spin on the last jobs still running on workers
+        while (remaining.load(std::memory_order_acquire) > 0) {
+            if (!runOne(0)) {
+                std::this_thread::yield();
+            }
+        }
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    bool JobSystem::runOne(uint32_t thread) {
+        Job job;
+        {
+            auto &own = *queues[thread];
+            std::lock_guard lock{own.mutex};
+            if (!own.jobs.empty()) {
+                job = std::move(own.jobs.back());
+                own.jobs.pop_back();
+            }
+        }
+        for (size_t i = 1; !job && i < queues.size(); i++) {
+            auto &victim = *queues[(thread + i) % queues.size()];
+            std::lock_guard lock{victim.mutex};
+            if (!victim.jobs.empty()) {
+                job = std::move(victim.jobs.front());
+                victim.jobs.pop_front();
+            }
+        }
+        if (!job) {
+            return false;
+        }
+        queuedJobs--;
+        job(thread);
+        return true;
+    }
+
+    void JobSystem::workerLoop(uint32_t thread) {
+        while (true) {
+            if (runOne(thread)) {
+                continue;
+            }
+            std::unique_lock lock{wakeMutex};
+            wake.wait(lock, [this] { return stopping || queuedJobs > 0; });
+            if (stopping && queuedJobs <= 0) {
+                return;
+            }
+        }
+    }
+} // k3d
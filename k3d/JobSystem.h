@@ -0,0 +1,61 @@
+#ifndef K3D_JOBSYSTEM_H
+#define K3D_JOBSYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace k3d {
+
+    // A fixed set of worker threads with one job deque each. Workers pop their own deque from the back and steal
+    // from the front of the others when it runs dry, so uneven jobs balance out without a central queue.
+    class JobSystem {
+    public:
+        explicit JobSystem(uint32_t workerCount);
+
+        ~JobSystem();
+
+        JobSystem(const JobSystem &) = delete;
+
+        JobSystem &operator=(const JobSystem &) = delete;
+
+        // workers plus the thread calling parallelFor(), which takes part as thread 0
+        [[nodiscard]] uint32_t threadCount() const { return static_cast<uint32_t>(workers.size()) + 1; }
+
+        // Calls function(index, thread) for every index in [0, count) and returns once all calls have finished.
+        // thread is in [0, threadCount()) and unique among concurrently running calls, so it can pick per-thread
+        // resources. The first exception thrown by a call is rethrown here. Only one thread may call it at a time,
+        // every caller would be thread 0.
+        void parallelFor(uint32_t count, const std::function<void(uint32_t index, uint32_t thread)> &function);
+
+    private:
+        using Job = std::function<void(uint32_t thread)>;
+
+        struct Queue {
+            std::mutex mutex;
+            std::deque<Job> jobs;
+        };
+
+        // runs one job from the thread's own deque or stolen from another, false if every deque is empty
+        bool runOne(uint32_t thread);
+
+        void workerLoop(uint32_t thread);
+
+        std::vector<std::unique_ptr<Queue>> queues;
+        std::vector<std::thread> workers;
+
+        std::mutex wakeMutex;
+        std::condition_variable wake;
+        // jobs pushed but not popped yet, briefly negative when a job is popped before it was counted
+        std::atomic<int64_t> queuedJobs{0};
+        bool stopping = false;
+    };
+
+} // k3d
+
+#endif //K3D_JOBSYSTEM_H
@@ -0,0 +1,206 @@
+#include "MemoryAllocator.h"
+
+#include <algorithm>
+#include <optional>
+
+namespace k3d {
+    namespace {
+        vk::DeviceSize alignUp(vk::DeviceSize value, vk::DeviceSize alignment) {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+    }
+
+    struct Allocation::Block {
+        vk::UniqueDeviceMemory memory;
+        uint32_t memoryTypeIndex;
+        bool linear;
+        vk::DeviceSize size;
+        void *mapped = nullptr;
+        // free ranges keyed by offset, adjacent ranges are always merged
+        std::map<vk::DeviceSize, vk::DeviceSize> freeRanges;
+        uint32_t allocationCount = 0;
+    };
+
+    Allocation::~Allocation() {
+        reset();
+    }
+
+    Allocation::Allocation(Allocation &&other) noexcept
+            : allocator{other.allocator}, block{other.block}, offset_{other.offset_}, size_{other.size_} {
+        other.allocator = nullptr;
+        other.block = nullptr;
+    }
+
+    Allocation &Allocation::operator=(Allocation &&other) noexcept {
+        if (this != &other) {
+            reset();
+            allocator = other.allocator;
+            block = other.block;
+            offset_ = other.offset_;
+            size_ = other.size_;
+            other.allocator = nullptr;
+            other.block = nullptr;
+        }
+        return *this;
+    }
+
+    void Allocation::reset() {
+        if (block != nullptr) {
+            allocator->free(block, offset_, size_);
+        }
+        allocator = nullptr;
+        block = nullptr;
+        offset_ = 0;
+        size_ = 0;
+    }
+
+    vk::DeviceMemory Allocation::memory() const {
+        return block != nullptr ? block->memory.get() : vk::DeviceMemory{};
+    }
+
+    void *Allocation::mapped() const {
+        if (block == nullptr || block->mapped == nullptr) {
+            return nullptr;
+        }
+        return static_cast<char *>(block->mapped) + offset_;
+    }
+
+    MemoryAllocator::MemoryAllocator(vk::Device device, const vk::PhysicalDeviceMemoryProperties &memoryProperties,
+                                     vk::DeviceSize bufferImageGranularity)
+            : device{device}, memoryProperties{memoryProperties},
+              bufferImageGranularity{bufferImageGranularity} {
+    }
+
+    MemoryAllocator::~MemoryAllocator() = default;
+
+    Allocation MemoryAllocator::allocate(const vk::MemoryRequirements &requirements, uint32_t memoryTypeIndex,
+                                         bool linear) {
+        std::lock_guard lock{mutex};
+        // with a granularity of 1 linear and optimal resources may be neighbours, so keep a single pool
+        bool poolLinear = bufferImageGranularity > 1 ? linear : true;
+
+        auto tryAllocate = [&](Allocation::Block &block) -> std::optional<vk::DeviceSize> {
+            for (auto [offset, size]: block.freeRanges) {
+                vk::DeviceSize aligned = alignUp(offset, requirements.alignment);
+                if (aligned + requirements.size > offset + size) {
+                    continue;
+                }
+                block.freeRanges.erase(offset);
+                if (aligned > offset) {
+                    block.freeRanges[offset] = aligned - offset;
+                }
+                vk::DeviceSize end = aligned + requirements.size;
+                if (end < offset + size) {
+                    block.freeRanges[end] = offset + size - end;
+                }
+                block.allocationCount++;
+                return aligned;
+            }
+            return std::nullopt;
+        };
+
+        auto makeAllocation = [&](Allocation::Block *block, vk::DeviceSize offset) {
+            Allocation allocation;
+            allocation.allocator = this;
+            allocation.block = block;
+            allocation.offset_ = offset;
+            allocation.size_ = requirements.size;
+            return allocation;
+        };
+
+        for (auto &block: blocks) {
+            if (block->memoryTypeIndex != memoryTypeIndex || block->linear != poolLinear) {
+                continue;
+            }
+            if (auto offset = tryAllocate(*block)) {
+                return makeAllocation(block.get(), *offset);
+            }
+        }
+
+        // resources larger than a block get a block of their own
+        auto block = createBlock(memoryTypeIndex, poolLinear,
+                                 std::max(preferredBlockSize(memoryTypeIndex), requirements.size));
+        return makeAllocation(block, *tryAllocate(*block));
+    }
+
+    void MemoryAllocator::free(Allocation::Block *block, vk::DeviceSize offset, vk::DeviceSize size) {
+        std::lock_guard lock{mutex};
+
+        auto next = block->freeRanges.lower_bound(offset);
+        if (next != block->freeRanges.end() && offset + size == next->first) {
+            size += next->second;
+            next = block->freeRanges.erase(next);
+        }
+        if (next != block->freeRanges.begin()) {
+            auto previous = std::prev(next);
+            if (previous->first + previous->second == offset) {
+                offset = previous->first;
+                size += previous->second;
+                block->freeRanges.erase(previous);
+            }
+        }
+        block->freeRanges[offset] = size;
+        block->allocationCount--;
+
+        if (block->allocationCount != 0) {
+            return;
+        }
+        // keep one empty block per pool around so resize churn does not hit the driver
+        bool hasOtherEmpty = std::any_of(blocks.begin(), blocks.end(), [block](const auto &other) {
+            return other.get() != block && other->allocationCount == 0 &&
+                   other->memoryTypeIndex == block->memoryTypeIndex && other->linear == block->linear;
+        });
+        if (hasOtherEmpty || block->size > preferredBlockSize(block->memoryTypeIndex)) {
+            std::erase_if(blocks, [block](const auto &other) { return other.get() == block; });
+        }
+    }
+
+    Allocation::Block *MemoryAllocator::createBlock(uint32_t memoryTypeIndex, bool linear, vk::DeviceSize size) {
+        vk::MemoryAllocateInfo allocInfo{
+                .allocationSize = size,
+                .memoryTypeIndex = memoryTypeIndex,
+        };
+
+        auto block = std::make_unique<Allocation::Block>();
+        try {
+            block->memory = device.allocateMemoryUnique(allocInfo);
+        }
+        catch (const std::exception &e) {
+            throw std::runtime_error("failed to allocate device memory block!");
+        }
+        deviceAllocations++;
+
+        block->memoryTypeIndex = memoryTypeIndex;
+        block->linear = linear;
+        block->size = size;
+        block->freeRanges[0] = size;
+        if (memoryProperties.memoryTypes[memoryTypeIndex].propertyFlags & vk::MemoryPropertyFlagBits::eHostVisible) {
+            block->mapped = device.mapMemory(block->memory.get(), 0, VK_WHOLE_SIZE);
+        }
+
+        blocks.push_back(std::move(block));
+        return blocks.back().get();
+    }
+
+    vk::DeviceSize MemoryAllocator::preferredBlockSize(uint32_t memoryTypeIndex) const {
+        // small heaps, e.g. the 256MB host visible device local heap, get proportionally smaller blocks
+        auto heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[memoryTypeIndex].heapIndex].size;
+        return std::min(BLOCK_SIZE, heapSize / 8);
+    }
+
+    MemoryAllocator::Stats MemoryAllocator::stats() const {
+        std::lock_guard lock{mutex};
+        Stats stats{.deviceAllocations = deviceAllocations};
+        for (const auto &block: blocks) {
+            vk::DeviceSize freeBytes = 0;
+            for (auto [offset, size]: block->freeRanges) {
+                freeBytes += size;
+            }
+            stats.blockCount++;
+            stats.allocationCount += block->allocationCount;
+            stats.blockBytes += block->size;
+            stats.usedBytes += block->size - freeBytes;
+        }
+        return stats;
+    }
+} // k3d
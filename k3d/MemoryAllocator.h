@@ -0,0 +1,106 @@
+#ifndef K3D_MEMORYALLOCATOR_H
+#define K3D_MEMORYALLOCATOR_H
+
+#define VULKAN_HPP_NO_CONSTRUCTORS
+
+#include <vulkan/vulkan.hpp>
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace k3d {
+
+    class MemoryAllocator;
+
+    // A range inside a MemoryAllocator block, handed back to the block when destroyed or reset.
+    class Allocation {
+    public:
+        Allocation() = default;
+
+        ~Allocation();
+
+        Allocation(const Allocation &) = delete;
+
+        Allocation &operator=(const Allocation &) = delete;
+
+        Allocation(Allocation &&other) noexcept;
+
+        Allocation &operator=(Allocation &&other) noexcept;
+
+        void reset();
+
+        [[nodiscard]] vk::DeviceMemory memory() const;
+
+        [[nodiscard]] vk::DeviceSize offset() const { return offset_; }
+
+        [[nodiscard]] vk::DeviceSize size() const { return size_; }
+
+        // host address of the allocation, blocks of host visible memory stay mapped for their whole lifetime
+        [[nodiscard]] void *mapped() const;
+
+        explicit operator bool() const { return block != nullptr; }
+
+    private:
+        friend class MemoryAllocator;
+
+        struct Block;
+
+        MemoryAllocator *allocator = nullptr;
+        Block *block = nullptr;
+        vk::DeviceSize offset_ = 0;
+        vk::DeviceSize size_ = 0;
+    };
+
+    // Pools device memory in large blocks per memory type and sub-allocates buffers and images from them,
+    // so the number of vkAllocateMemory calls stays far below maxMemoryAllocationCount.
+    class MemoryAllocator {
+    public:
+        struct Stats {
+            uint32_t blockCount;
+            uint32_t allocationCount;
+            vk::DeviceSize blockBytes;
+            vk::DeviceSize usedBytes;
+            // vkAllocateMemory calls made over the allocator's lifetime
+            uint64_t deviceAllocations;
+        };
+
+        static constexpr vk::DeviceSize BLOCK_SIZE = 64 * 1024 * 1024;
+
+        MemoryAllocator(vk::Device device, const vk::PhysicalDeviceMemoryProperties &memoryProperties,
+                        vk::DeviceSize bufferImageGranularity);
+
+        ~MemoryAllocator();
+
+        MemoryAllocator(const MemoryAllocator &) = delete;
+
+        MemoryAllocator &operator=(const MemoryAllocator &) = delete;
+
+        // linear is true for buffers and linear images, false for optimally tiled images; the two never share a
+        // block when bufferImageGranularity is larger than 1
+        Allocation allocate(const vk::MemoryRequirements &requirements, uint32_t memoryTypeIndex, bool linear);
+
+        [[nodiscard]] Stats stats() const;
+
+    private:
+        friend class Allocation;
+
+        void free(Allocation::Block *block, vk::DeviceSize offset, vk::DeviceSize size);
+
+        Allocation::Block *createBlock(uint32_t memoryTypeIndex, bool linear, vk::DeviceSize size);
+
+        [[nodiscard]] vk::DeviceSize preferredBlockSize(uint32_t memoryTypeIndex) const;
+
+        vk::Device device;
+        vk::PhysicalDeviceMemoryProperties memoryProperties;
+        vk::DeviceSize bufferImageGranularity;
+
+        mutable std::mutex mutex;
+        std::vector<std::unique_ptr<Allocation::Block>> blocks;
+        uint64_t deviceAllocations = 0;
+    };
+
+} // k3d
+
+#endif //K3D_MEMORYALLOCATOR_H
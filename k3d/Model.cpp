@@ -4,61 +4,367 @@
 
 #include "Model.h"
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <numeric>
+#include <unordered_map>
+
 namespace k3d {
-    Model::Model(Device &device, const std::vector<Vertex> &vertices) : device{device} {
-        createVertexBuffers(vertices);
+    namespace {
+        struct VertexHash {
+            size_t operator()(const Model::Vertex &v) const {
+                uint32_t bits[5];
+                std::memcpy(bits, &v.position, sizeof(v.position));
+                std::memcpy(bits + 2, &v.color, sizeof(v.color));
+                size_t hash = 0;
+                for (auto b: bits) {
+                    hash = hash * 0x9E3779B97F4A7C15ull + b;
+                }
+                return hash;
+            }
+        };
+
+        struct VertexEqual {
+            bool operator()(const Model::Vertex &a, const Model::Vertex &b) const {
+                return std::memcmp(&a.position, &b.position, sizeof(a.position)) == 0 &&
+                       std::memcmp(&a.color, &b.color, sizeof(a.color)) == 0;
+            }
+        };
+
+        std::array<int16_t, 2> snorm16(glm::vec2 position) {
+            if (!(std::abs(position.x) <= 1.0f && std::abs(position.y) <= 1.0f)) {
+                throw std::runtime_error("vertex position outside of [-1, 1] cannot be stored as snorm16");
+            }
+            return {static_cast<int16_t>(std::lround(position.x * 32767.0f)),
+                    static_cast<int16_t>(std::lround(position.y * 32767.0f))};
+        }
+
+        std::array<uint8_t, 4> unorm8(glm::vec3 color) {
+            auto channel = [](float c) { return static_cast<uint8_t>(std::lround(std::clamp(c, 0.0f, 1.0f) * 255.0f)); };
+            return {channel(color.r), channel(color.g), channel(color.b), 255};
+        }
+
+        // spreads the low 16 bits of x over the even bits of the result
+        uint32_t spreadBits(uint32_t x) {
+            x &= 0xffff;
+            x = (x | (x << 8)) & 0x00ff00ff;
+            x = (x | (x << 4)) & 0x0f0f0f0f;
+            x = (x | (x << 2)) & 0x33333333;
+            x = (x | (x << 1)) & 0x55555555;
+            return x;
+        }
+    }
+
+    void Model::Builder::weld() {
+        if (indices.empty()) {
+            indices.resize(vertices.size());
+            std::iota(indices.begin(), indices.end(), 0);
+        }
+
+        std::unordered_map<Vertex, uint32_t, VertexHash, VertexEqual> unique;
+        unique.reserve(vertices.size() / 2);
+        std::vector<Vertex> welded;
+        std::vector<uint32_t> remap(vertices.size());
+        for (uint32_t i = 0; i < vertices.size(); i++) {
+            auto [it, inserted] = unique.try_emplace(vertices[i], static_cast<uint32_t>(welded.size()));
+            if (inserted) {
+                welded.push_back(vertices[i]);
+            }
+            remap[i] = it->second;
+        }
+        for (auto &index: indices) {
+            index = remap[index];
+        }
+        vertices = std::move(welded);
+    }
+
+    void Model::Builder::optimize() {
+        if (indices.empty()) {
+            weld();
+        }
+        size_t triangleCount = indices.size() / 3;
+
+        glm::vec2 low{std::numeric_limits<float>::max()};
+        glm::vec2 high{std::numeric_limits<float>::lowest()};
+        for (const auto &v: vertices) {
+            low = glm::min(low, v.position);
+            high = glm::max(high, v.position);
+        }
+        glm::vec2 scale = 65535.0f / glm::max(high - low, glm::vec2{1e-20f});
+
+        std::vector<std::pair<uint32_t, uint32_t>> order(triangleCount);
+        for (uint32_t t = 0; t < triangleCount; t++) {
+            glm::vec2 centroid = (vertices[indices[t * 3]].position + vertices[indices[t * 3 + 1]].position +
+                                  vertices[indices[t * 3 + 2]].position) / 3.0f;
+            glm::vec2 cell = (centroid - low) * scale;
+            order[t] = {spreadBits(static_cast<uint32_t>(cell.x)) | (spreadBits(static_cast<uint32_t>(cell.y)) << 1),
+                        t};
+        }
+        std::sort(order.begin(), order.end());
+
+        constexpr uint32_t UNUSED = std::numeric_limits<uint32_t>::max();
+        std::vector<uint32_t> remap(vertices.size(), UNUSED);
+        std::vector<Vertex> sortedVertices;
+        std::vector<uint32_t> sortedIndices;
+        sortedVertices.reserve(vertices.size());
+        sortedIndices.reserve(indices.size());
+        for (auto [code, t]: order) {
+            for (uint32_t corner = 0; corner < 3; corner++) {
+                uint32_t index = indices[t * 3 + corner];
+                if (remap[index] == UNUSED) {
+                    remap[index] = static_cast<uint32_t>(sortedVertices.size());
+                    sortedVertices.push_back(vertices[index]);
+                }
+                sortedIndices.push_back(remap[index]);
+            }
+        }
+        vertices = std::move(sortedVertices);
+        indices = std::move(sortedIndices);
     }
 
-    void Model::createVertexBuffers(const std::vector<Vertex> &vertices) {
+    Model::Model(Device &device, const std::vector<Vertex> &vertices, Usage usage, VertexLayout layout)
+            : device{device}, usage{usage}, layout{layout} {
+        auto batch = device.uploads().beginBatch();
+        createVertexBuffers(vertices, batch);
+        createInstanceBuffers({}, batch);
+        uploadValue_ = batch.submit();
+    }
+
+    Model::Model(Device &device, const Builder &builder, Usage usage, VertexLayout layout)
+            : device{device}, usage{usage}, layout{layout} {
+        // every buffer of the model is staged into one submission
+        auto batch = device.uploads().beginBatch();
+        createVertexBuffers(builder.vertices, batch);
+        createIndexBuffers(builder.indices, batch);
+        createInstanceBuffers(builder.instances, batch);
+        uploadValue_ = batch.submit();
+    }
+
+    void Model::createVertexBuffers(const std::vector<Vertex> &vertices, UploadBatch &batch) {
         vertexCount = vertices.size();
         assert(vertexCount >= 3 && "at least 3 vertices are required");
-        vk::DeviceSize bufferSize = sizeof(vertices[0]) * vertexCount;
+        if (usage == Usage::Streaming) {
+            source = vertices;
+            return;
+        }
+        std::vector<std::byte> encoded;
+        const void *data = vertices.data();
+        if (layout != VertexLayout::Float32) {
+            encoded = encodeVertices(vertices, layout);
+            data = encoded.data();
+        }
+        createBuffer(data, vertexBytes(), vk::BufferUsageFlagBits::eVertexBuffer, vertexBuffer, vertexMemory, batch);
+    }
+
+    void Model::createIndexBuffers(const std::vector<uint32_t> &indices, UploadBatch &batch) {
+        indexCount = indices.size();
+        if (indexCount == 0) {
+            return;
+        }
+        vk::DeviceSize bufferSize = sizeof(indices[0]) * indexCount;
+        createBuffer(indices.data(), bufferSize, vk::BufferUsageFlagBits::eIndexBuffer, indexBuffer, indexMemory,
+                     batch);
+    }
+
+    void Model::createInstanceBuffers(const std::vector<Instance> &instances, UploadBatch &batch) {
+        // the pipeline always consumes binding 1, so a plain model gets a single identity instance
+        const std::vector<Instance> identity(1);
+        const auto &data = instances.empty() ? identity : instances;
+        instanceCount = data.size();
+        vk::DeviceSize bufferSize = sizeof(data[0]) * instanceCount;
+        createBuffer(data.data(), bufferSize, vk::BufferUsageFlagBits::eVertexBuffer, instanceBuffer, instanceMemory,
+                     batch);
+    }
 
-        device.createBuffer(bufferSize,
-                            vk::BufferUsageFlagBits::eVertexBuffer,
-                            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
-                            vertexBuffer, vertexMemory
+    void Model::createBuffer(const void *data, vk::DeviceSize size, vk::BufferUsageFlags bufferUsage,
+                             vk::UniqueBuffer &buffer, Allocation &memory, UploadBatch &batch) {
+        if (usage == Usage::Dynamic) {
+            device.createBuffer(size,
+                                bufferUsage,
+                                vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                                buffer, memory
+            );
+            memcpy(memory.mapped(), data, size);
+            return;
+        }
+
+        device.createBuffer(size,
+                            bufferUsage | vk::BufferUsageFlagBits::eTransferDst,
+                            vk::MemoryPropertyFlagBits::eDeviceLocal,
+                            buffer, memory
         );
-        void *data = device.device().mapMemory(vertexMemory.get(), 0, bufferSize);
-        memcpy(data, vertices.data(), bufferSize);
-        device.device().unmapMemory(vertexMemory.get());
+        batch.copyBuffer(data, size, buffer.get());
+    }
+
+    void Model::update(const std::vector<Vertex> &vertices) {
+        assert(usage == Usage::Dynamic && "only dynamic models can be updated");
+        assert(vertices.size() == vertexCount && "vertex count of a model is fixed");
+        if (layout == VertexLayout::Float32) {
+            memcpy(vertexMemory.mapped(), vertices.data(), vertexBytes());
+        } else {
+            memcpy(vertexMemory.mapped(), encodeVertices(vertices, layout).data(), vertexBytes());
+        }
+    }
+
+    void Model::stream(StreamingBuffer &buffer, const std::vector<Vertex> &vertices) {
+        assert(usage == Usage::Streaming && "only streaming models can be streamed");
+        assert(vertices.size() == vertexCount && "vertex count of a model is fixed");
+        // encoded straight into the mapped slot, no intermediate copy
+        auto range = buffer.allocate(vertexBytes(), sizeof(float));
+        encodeVertices(vertices, layout, static_cast<std::byte *>(range.data));
+        streamedBuffer = buffer.buffer();
+        streamedOffset = range.offset;
+    }
+
+    std::vector<std::byte> Model::encodeVertices(const std::vector<Vertex> &vertices, VertexLayout layout) {
+        std::vector<std::byte> encoded(vertices.size() * Vertex::size(layout));
+        encodeVertices(vertices, layout, encoded.data());
+        return encoded;
+    }
+
+    void Model::encodeVertices(const std::vector<Vertex> &vertices, VertexLayout layout, std::byte *encoded) {
+        auto stride = Vertex::size(layout);
+        for (size_t i = 0; i < vertices.size(); i++) {
+            auto *out = encoded + i * stride;
+            switch (layout) {
+                case VertexLayout::Float32:
+                    std::memcpy(out, &vertices[i], sizeof(Vertex));
+                    break;
+                case VertexLayout::Packed: {
+                    PackedVertex packed{.position = snorm16(vertices[i].position), .color = unorm8(vertices[i].color)};
+                    std::memcpy(out, &packed, sizeof(packed));
+                    break;
+                }
+                case VertexLayout::PositionOnly: {
+                    PositionVertex packed{.position = snorm16(vertices[i].position)};
+                    std::memcpy(out, &packed, sizeof(packed));
+                    break;
+                }
+            }
+        }
     }
 
     void Model::bind(vk::CommandBuffer commandBuffer) {
-        commandBuffer.bindVertexBuffers(0, vertexBuffer.get(), vk::DeviceSize{0});
+        bool streaming = usage == Usage::Streaming;
+        std::array<vk::Buffer, 2> buffers{streaming ? streamedBuffer : vertexBuffer.get(), instanceBuffer.get()};
+        std::array<vk::DeviceSize, 2> offsets{streaming ? streamedOffset : 0, 0};
+        commandBuffer.bindVertexBuffers(0, buffers, offsets);
+        if (indexCount > 0) {
+            commandBuffer.bindIndexBuffer(indexBuffer.get(), 0, vk::IndexType::eUint32);
+        }
     }
 
     void Model::draw(vk::CommandBuffer commandBuffer) const {
-        commandBuffer.draw(vertexCount, 1, 0, 0);
+        draw(commandBuffer, 0, instanceCount);
+    }
+
+    void Model::draw(vk::CommandBuffer commandBuffer, uint32_t firstInstance, uint32_t count) const {
+        if (indexCount > 0) {
+            commandBuffer.drawIndexed(indexCount, count, 0, 0, firstInstance);
+        } else {
+            commandBuffer.draw(vertexCount, count, 0, firstInstance);
+        }
     }
 
     Model::~Model() = default;
 
-    std::vector<vk::VertexInputBindingDescription> Model::Vertex::getBindingDescriptions() {
+    uint32_t Model::Vertex::size(VertexLayout layout) {
+        switch (layout) {
+            case VertexLayout::Packed:
+                return sizeof(PackedVertex);
+            case VertexLayout::PositionOnly:
+                return sizeof(PositionVertex);
+            default:
+                return sizeof(Vertex);
+        }
+    }
+
+    std::vector<vk::VertexInputBindingDescription> Model::Vertex::getBindingDescriptions(VertexLayout layout) {
         return {
                 {
                         .binding = 0,
-                        .stride = sizeof(Vertex),
+                        .stride = size(layout),
                         .inputRate = vk::VertexInputRate::eVertex,
                 },
+                {
+                        .binding = 1,
+                        .stride = sizeof(Instance),
+                        .inputRate = vk::VertexInputRate::eInstance,
+                },
         };
     }
 
-    std::vector<vk::VertexInputAttributeDescription> Model::Vertex::getAttributeDescriptions() {
-        return {
+    std::vector<vk::VertexInputAttributeDescription> Model::Vertex::getAttributeDescriptions(VertexLayout layout) {
+        std::vector<vk::VertexInputAttributeDescription> attributes;
+        switch (layout) {
+            case VertexLayout::Float32:
+                attributes = {
+                        {
+                                .location = 0,
+                                .binding = 0,
+                                .format = vk::Format::eR32G32Sfloat,
+                                .offset = offsetof(Model::Vertex, position),
+                        },
+                        {
+                                .location = 1,
+                                .binding = 0,
+                                .format = vk::Format::eR32G32B32Sfloat,
+                                .offset = offsetof(Model::Vertex, color),
+                        },
+                };
+                break;
+            case VertexLayout::Packed:
+                // normalized formats arrive in the shader as floats, the vec3 color input ignores alpha
+                attributes = {
+                        {
+                                .location = 0,
+                                .binding = 0,
+                                .format = vk::Format::eR16G16Snorm,
+                                .offset = offsetof(Model::PackedVertex, position),
+                        },
+                        {
+                                .location = 1,
+                                .binding = 0,
+                                .format = vk::Format::eR8G8B8A8Unorm,
+                                .offset = offsetof(Model::PackedVertex, color),
+                        },
+                };
+                break;
+            case VertexLayout::PositionOnly:
+                attributes = {
+                        {
+                                .location = 0,
+                                .binding = 0,
+                                .format = vk::Format::eR16G16Snorm,
+                                .offset = offsetof(Model::PositionVertex, position),
+                        },
+                };
+                break;
+        }
+        std::vector<vk::VertexInputAttributeDescription> instanceAttributes{
                 {
-                        .location = 0,
-                        .binding = 0,
+                        .location = 2,
+                        .binding = 1,
                         .format = vk::Format::eR32G32Sfloat,
-                        .offset = offsetof(Model::Vertex, position),
+                        .offset = offsetof(Model::Instance, offset),
                 },
                 {
-                        .location = 1,
-                        .binding = 0,
+                        .location = 3,
+                        .binding = 1,
+                        .format = vk::Format::eR32Sfloat,
+                        .offset = offsetof(Model::Instance, scale),
+                },
+                {
+                        .location = 4,
+                        .binding = 1,
                         .format = vk::Format::eR32G32B32Sfloat,
-                        .offset = offsetof(Model::Vertex, color),
-
-                }
+                        .offset = offsetof(Model::Instance, colorBias),
+                },
         };
+        attributes.insert(attributes.end(), instanceAttributes.begin(), instanceAttributes.end());
+        return attributes;
     }
 } // k3d
\ No newline at end of file
@@ -6,27 +6,92 @@
 #define K3D_MODEL_H
 
 #include "device.h"
+#include "StreamingBuffer.h"
 
 #define GLM_FORCE_RADIANS
 #define GLM_FORCE_DEPTH_ZERO_TO_ONE
 
 #include <glm/glm.hpp>
 
+#include <array>
+#include <cstddef>
+
 namespace k3d {
 
+    // How a model stores its vertices on the GPU. Models are always built from Model::Vertex, other layouts are
+    // encoded while uploading and need positions inside [-1, 1].
+    enum class VertexLayout {
+        // Model::Vertex as is, 20 bytes
+        Float32,
+        // snorm16 position and unorm8 color, 8 bytes
+        Packed,
+        // snorm16 position only, 4 bytes, triangle_derived.vert computes the color like sierpinskiColor()
+        PositionOnly,
+    };
+
     class Model {
     public:
         struct Vertex {
             glm::vec2 position;
             glm::vec3 color;
 
-            static std::vector<vk::VertexInputBindingDescription> getBindingDescriptions();
+            // binding 0 holds the vertices in the given layout, binding 1 the instances
+            static std::vector<vk::VertexInputBindingDescription>
+            getBindingDescriptions(VertexLayout layout = VertexLayout::Float32);
+
+            static std::vector<vk::VertexInputAttributeDescription>
+            getAttributeDescriptions(VertexLayout layout = VertexLayout::Float32);
+
+            static uint32_t size(VertexLayout layout);
+        };
+
+        struct PackedVertex {
+            std::array<int16_t, 2> position;
+            std::array<uint8_t, 4> color;
+        };
+
+        struct PositionVertex {
+            std::array<int16_t, 2> position;
+        };
+
+        // Per-instance attributes on binding 1. The vertex shader draws position * scale + offset with
+        // color * scale + colorBias, which keeps affine position based coloring continuous across instances.
+        struct Instance {
+            glm::vec2 offset{0.0f};
+            float scale = 1.0f;
+            glm::vec3 colorBias{0.0f};
+        };
+
+        enum class Usage {
+            // uploaded once through a staging buffer into device local memory
+            Static,
+            // kept in host visible memory so it can be rewritten with update()
+            Dynamic,
+            // Vertices stay on the CPU and are written into a StreamingBuffer slot every frame with stream(), so
+            // they can change each frame while earlier frames are still in flight. Indices and instances are static.
+            Streaming,
+        };
+
+        struct Builder {
+            std::vector<Vertex> vertices;
+            // triangle list indices into vertices, empty for a non-indexed triangle soup
+            std::vector<uint32_t> indices;
+            // copies of the mesh to draw, empty draws it once untransformed
+            std::vector<Instance> instances;
 
-            static std::vector<vk::VertexInputAttributeDescription> getAttributeDescriptions();
+            // merges bit-identical vertices and indexes the result, a soup is treated as indices 0..n-1
+            void weld();
 
+            // Sorts triangles along a Z-order curve over their centroids for post-transform cache locality, then
+            // renumbers vertices in first-use order so vertex fetches walk the buffer front to back.
+            void optimize();
         };
 
-        Model(Device &device, const std::vector<Vertex> &vertices);
+        Model(Device &device, const std::vector<Vertex> &vertices, Usage usage = Usage::Static,
+              VertexLayout layout = VertexLayout::Float32);
+
+        Model(Device &device, const Builder &builder, Usage usage = Usage::Static,
+              VertexLayout layout = VertexLayout::Float32);
 
         ~ Model();
 
@@ -38,14 +103,66 @@ namespace k3d {
 
         void draw(vk::CommandBuffer commandBuffer) const;
 
+        // draws instances [firstInstance, firstInstance + count) only
+        void draw(vk::CommandBuffer commandBuffer, uint32_t firstInstance, uint32_t count) const;
+
+        [[nodiscard]] uint32_t getInstanceCount() const { return instanceCount; }
+
+        [[nodiscard]] VertexLayout getVertexLayout() const { return layout; }
+
+        // size of the vertex buffer, smaller than vertexCount * sizeof(Vertex) for compact layouts
+        [[nodiscard]] vk::DeviceSize vertexBytes() const { return vk::DeviceSize{vertexCount} * Vertex::size(layout); }
+
+        // vertices in the given layout, throws if a position cannot be represented
+        static std::vector<std::byte> encodeVertices(const std::vector<Vertex> &vertices, VertexLayout layout);
+
+        // encodes into out, which has room for vertices.size() * Vertex::size(layout) bytes
+        static void encodeVertices(const std::vector<Vertex> &vertices, VertexLayout layout, std::byte *out);
+
+        // rewrites the vertices of a dynamic model, the buffer must not be in use by the GPU
+        void update(const std::vector<Vertex> &vertices);
+
+        // Writes the vertices of a streaming model into the buffer's current slot, later binds use that copy.
+        // The vertex count is fixed, and the model must be streamed before every frame that draws it.
+        void stream(StreamingBuffer &buffer, const std::vector<Vertex> &vertices);
+
+        // the vertices a streaming model was built from
+        [[nodiscard]] const std::vector<Vertex> &sourceVertices() const { return source; }
+
+        // upload context value the model's buffers are complete at, submissions drawing it must wait for it
+        [[nodiscard]] uint64_t uploadValue() const { return uploadValue_; }
+
     private:
-        void createVertexBuffers(const std::vector<Vertex> &vertices);
+        void createVertexBuffers(const std::vector<Vertex> &vertices, UploadBatch &batch);
+
+        void createIndexBuffers(const std::vector<uint32_t> &indices, UploadBatch &batch);
+
+        void createInstanceBuffers(const std::vector<Instance> &instances, UploadBatch &batch);
+
+        // device local for static models (filled asynchronously through the upload batch), host visible for
+        // dynamic ones
+        void createBuffer(const void *data, vk::DeviceSize size, vk::BufferUsageFlags bufferUsage,
+                          vk::UniqueBuffer &buffer, Allocation &memory, UploadBatch &batch);
 
         Device &device;
+        Usage usage;
+        VertexLayout layout;
         vk::UniqueBuffer vertexBuffer;
-        vk::UniqueDeviceMemory vertexMemory;
+        Allocation vertexMemory;
         uint32_t vertexCount{};
+        std::vector<Vertex> source;
+        vk::Buffer streamedBuffer;
+        vk::DeviceSize streamedOffset{};
+
+        vk::UniqueBuffer indexBuffer;
+        Allocation indexMemory;
+        uint32_t indexCount{};
+
+        vk::UniqueBuffer instanceBuffer;
+        Allocation instanceMemory;
+        uint32_t instanceCount{};
 
+        uint64_t uploadValue_{};
     };
 
 } // k3d
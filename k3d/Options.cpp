@@ -0,0 +1,40 @@
+#include "Options.h"
+
+namespace k3d {
+    std::optional<FractalKind> parseFractalKind(std::string_view name) {
+        if (name == "sierpinski") return FractalKind::Sierpinski;
+        if (name == "carpet") return FractalKind::Carpet;
+        if (name == "koch") return FractalKind::Koch;
+        return std::nullopt;
+    }
+
+    std::optional<VertexLayout> parseVertexLayout(std::string_view name) {
+        if (name == "float32") return VertexLayout::Float32;
+        if (name == "packed") return VertexLayout::Packed;
+        if (name == "position") return VertexLayout::PositionOnly;
+        return std::nullopt;
+    }
+
+    std::optional<vk::PresentModeKHR> parsePresentMode(std::string_view name) {
+        if (name == "immediate") return vk::PresentModeKHR::eImmediate;
+        if (name == "mailbox") return vk::PresentModeKHR::eMailbox;
+        if (name == "fifo") return vk::PresentModeKHR::eFifo;
+        if (name == "fifo-relaxed") return vk::PresentModeKHR::eFifoRelaxed;
+        return std::nullopt;
+    }
+
+    std::string_view presentModeName(vk::PresentModeKHR presentMode) {
+        switch (presentMode) {
+            case vk::PresentModeKHR::eImmediate:
+                return "immediate";
+            case vk::PresentModeKHR::eMailbox:
+                return "mailbox";
+            case vk::PresentModeKHR::eFifo:
+                return "fifo";
+            case vk::PresentModeKHR::eFifoRelaxed:
+                return "fifo-relaxed";
+            default:
+                return {};
+        }
+    }
+} // k3d
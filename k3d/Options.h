@@ -0,0 +1,26 @@
+#ifndef K3D_OPTIONS_H
+#define K3D_OPTIONS_H
+
+#include "GpuFractal.h"
+#include "Model.h"
+
+#include <optional>
+#include <string_view>
+
+namespace k3d {
+
+    // command line spellings of the enum options shared by the app and the bench, nullopt for unknown names
+
+    std::optional<FractalKind> parseFractalKind(std::string_view name);
+
+    std::optional<VertexLayout> parseVertexLayout(std::string_view name);
+
+    // immediate, mailbox, fifo or fifo-relaxed
+    std::optional<vk::PresentModeKHR> parsePresentMode(std::string_view name);
+
+    // the spelling parsePresentMode() accepts, empty for modes it does not know
+    std::string_view presentModeName(vk::PresentModeKHR presentMode);
+
+} // k3d
+
+#endif //K3D_OPTIONS_H
@@ -5,62 +5,59 @@
 #include "Pipeline.h"
 #include "Model.h"
 
-#include <fstream>
-#include <iostream>
-
 namespace k3d {
-    Pipeline::Pipeline(Device &device, const std::string &vertFilePath, const std::string &fragFilePath,
+    Pipeline::Pipeline(Device &device, std::span<const uint32_t> vertCode, std::span<const uint32_t> fragCode,
                        const PipelineConfigInfo &configInfo) : device(device) {
-        pipeline = createGraphicsPipeline(vertFilePath, fragFilePath, configInfo);
+        vertShaderModule = createShaderModule(vertCode);
+        fragShaderModule = createShaderModule(fragCode);
+        pipeline = createGraphicsPipeline(vertShaderModule.get(), fragShaderModule.get(), configInfo, nullptr);
     }
 
-    std::vector<char> Pipeline::readFile(const std::string &filePath) {
-        std::ifstream file(filePath, std::ios::ate | std::ios::binary);
-        if (!file.is_open()) {
-            throw std::runtime_error("failed to open file: " + filePath);
-        }
-        std::streamsize fileSize = file.tellg();
-        std::vector<char> buffer(fileSize);
-        file.seekg(0);
-        file.read(buffer.data(), fileSize);
-        file.close();
-        return buffer;
+    Pipeline::Pipeline(Device &device, vk::ShaderModule vertModule, vk::ShaderModule fragModule,
+                       const PipelineConfigInfo &configInfo, const vk::SpecializationInfo *specializationInfo)
+            : device(device) {
+        pipeline = createGraphicsPipeline(vertModule, fragModule, configInfo, specializationInfo);
     }
 
     vk::UniquePipeline
-    Pipeline::createGraphicsPipeline(const std::string &vertFilePath, const std::string &fragFilePath,
-                                     const PipelineConfigInfo &configInfo) {
-        auto vert = readFile(vertFilePath);
-        auto frag = readFile(fragFilePath);
-        vertShaderModule = createShaderModule(vert);
-        fragShaderModule = createShaderModule(frag);
-
+    Pipeline::createGraphicsPipeline(vk::ShaderModule vertModule, vk::ShaderModule fragModule,
+                                     const PipelineConfigInfo &configInfo,
+                                     const vk::SpecializationInfo *specializationInfo) {
         vk::PipelineShaderStageCreateInfo stageCreateInfos[2]{
                 {
                         .stage = vk::ShaderStageFlagBits::eVertex,
-                        .module = vertShaderModule.get(),
+                        .module = vertModule,
                         .pName = "main",
+                        .pSpecializationInfo = specializationInfo,
                 },
                 {
                         .stage = vk::ShaderStageFlagBits::eFragment,
-                        .module = fragShaderModule.get(),
+                        .module = fragModule,
                         .pName = "main",
+                        .pSpecializationInfo = specializationInfo,
                 }
         };
 
-        auto vertexBindingDescriptions = Model::Vertex::getBindingDescriptions();
-        auto vertexAttributeDescriptions = Model::Vertex::getAttributeDescriptions();
+        const auto &bindingDescriptions = configInfo.bindingDescriptions;
+        const auto &attributeDescriptions = configInfo.attributeDescriptions;
         vk::PipelineVertexInputStateCreateInfo vertexInputStateCreateInfo{
-                .vertexBindingDescriptionCount = static_cast<uint32_t>(vertexBindingDescriptions.size()),
-                .pVertexBindingDescriptions = vertexBindingDescriptions.data(),
-                .vertexAttributeDescriptionCount = static_cast<uint32_t>(vertexAttributeDescriptions.size()),
-                .pVertexAttributeDescriptions = vertexAttributeDescriptions.data(),
+                .vertexBindingDescriptionCount = static_cast<uint32_t>(bindingDescriptions.size()),
+                .pVertexBindingDescriptions = bindingDescriptions.data(),
+                .vertexAttributeDescriptionCount = static_cast<uint32_t>(attributeDescriptions.size()),
+                .pVertexAttributeDescriptions = attributeDescriptions.data(),
         };
         vk::PipelineViewportStateCreateInfo viewportInfo{
                 .viewportCount = 1,
-                .pViewports = &configInfo.viewport,
+                .pViewports = nullptr,
                 .scissorCount = 1,
-                .pScissors = &configInfo.scissor,
+                .pScissors = nullptr,
+        };
+        // configInfo may be a copy whose pAttachments still points into the original
+        auto colorBlendInfo = configInfo.colorBlendInfo;
+        colorBlendInfo.pAttachments = &configInfo.colorBlendAttachment;
+        vk::PipelineDynamicStateCreateInfo dynamicStateInfo{
+                .dynamicStateCount = static_cast<uint32_t>(configInfo.dynamicStates.size()),
+                .pDynamicStates = configInfo.dynamicStates.data(),
         };
 
         vk::GraphicsPipelineCreateInfo pipelineCreateInfo{
@@ -72,7 +69,8 @@ namespace k3d {
                 .pRasterizationState = &configInfo.rasterizationInfo,
                 .pMultisampleState = &configInfo.multisampleInfo,
                 .pDepthStencilState = &configInfo.depthStencilInfo,
-                .pColorBlendState = &configInfo.colorBlendInfo,
+                .pColorBlendState = &colorBlendInfo,
+                .pDynamicState = &dynamicStateInfo,
                 .layout = configInfo.pipelineLayout,
                 .renderPass = configInfo.renderPass,
                 .subpass = configInfo.subpass,
@@ -82,17 +80,17 @@ namespace k3d {
         };
 
         try {
-            return device.device().createGraphicsPipelineUnique(vk::PipelineCache(), pipelineCreateInfo).value;
+            return device.pipelineCache().createGraphicsPipeline(pipelineCreateInfo);
         } catch (const std::exception &e) {
             throw std::runtime_error("failed to create graphics pipeline");
         }
 
     }
 
-    vk::UniqueShaderModule Pipeline::createShaderModule(const std::vector<char> &code) {
+    vk::UniqueShaderModule Pipeline::createShaderModule(std::span<const uint32_t> code) {
         vk::ShaderModuleCreateInfo createInfo{
-                .codeSize = code.size(),
-                .pCode = reinterpret_cast<const uint32_t *>(code.data()),
+                .codeSize = code.size_bytes(),
+                .pCode = code.data(),
         };
         try {
             return device.device().createShaderModuleUnique(createInfo);
@@ -104,21 +102,10 @@ namespace k3d {
     Pipeline::~Pipeline() =
     default;
 
-    PipelineConfigInfo Pipeline::defaultConfig(uint32_t width, uint32_t height) {
+    PipelineConfigInfo Pipeline::defaultConfig() {
         PipelineConfigInfo configInfo{
-                .viewport = {
-                        .x = 0.0f,
-                        .y = 0.0f,
-                        .width = static_cast<float>(width),
-                        .height = static_cast<float>(height),
-                        .minDepth = 0.0f,
-                        .maxDepth = 1.0f,
-                },
-
-                .scissor = {
-                        .offset = {0, 0},
-                        .extent = {width, height}
-                },
+                .bindingDescriptions = Model::Vertex::getBindingDescriptions(),
+                .attributeDescriptions = Model::Vertex::getAttributeDescriptions(),
 
                 .inputAssemblyInfo = {
                         .topology = vk::PrimitiveTopology::eTriangleList,
@@ -179,6 +166,8 @@ namespace k3d {
                         .minDepthBounds = 0.0f,  // Optional
                         .maxDepthBounds = 1.0f,  // Optional
                 },
+
+                .dynamicStates = {vk::DynamicState::eViewport, vk::DynamicState::eScissor},
         };
 
         return configInfo;
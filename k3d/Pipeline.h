@@ -5,20 +5,23 @@
 #ifndef K3D_PIPELINE_H
 #define K3D_PIPELINE_H
 
-#include <string>
+#include <span>
 #include <vector>
 #include "device.h"
 
 namespace k3d {
     struct PipelineConfigInfo {
-        vk::Viewport viewport;
-        vk::Rect2D scissor;
+        // Model::Vertex's descriptions for the model's VertexLayout
+        std::vector<vk::VertexInputBindingDescription> bindingDescriptions;
+        std::vector<vk::VertexInputAttributeDescription> attributeDescriptions;
         vk::PipelineInputAssemblyStateCreateInfo inputAssemblyInfo;
         vk::PipelineRasterizationStateCreateInfo rasterizationInfo;
         vk::PipelineMultisampleStateCreateInfo multisampleInfo;
         vk::PipelineColorBlendAttachmentState colorBlendAttachment;
         vk::PipelineColorBlendStateCreateInfo colorBlendInfo;
         vk::PipelineDepthStencilStateCreateInfo depthStencilInfo;
+        // viewport and scissor are dynamic by default so the pipeline survives swapchain resizes
+        std::vector<vk::DynamicState> dynamicStates;
         vk::PipelineLayout pipelineLayout;
         vk::RenderPass renderPass;
         uint32_t subpass = 0;
@@ -27,11 +30,19 @@ namespace k3d {
 
     class Pipeline {
     public:
+        // the SPIR-V only has to outlive the constructor, see ShaderCode and the generated shaders/*.h headers
         Pipeline(Device &device,
-                 const std::string &vertFilePath,
-                 const std::string &fragFilePath,
+                 std::span<const uint32_t> vertCode,
+                 std::span<const uint32_t> fragCode,
                  const PipelineConfigInfo &configInfo);
 
+        // uses shader modules owned by the caller, e.g. a PipelineRegistry, they only have to outlive the constructor
+        Pipeline(Device &device,
+                 vk::ShaderModule vertModule,
+                 vk::ShaderModule fragModule,
+                 const PipelineConfigInfo &configInfo,
+                 const vk::SpecializationInfo *specializationInfo = nullptr);
+
         ~ Pipeline();
 
         Pipeline(const Pipeline &) = delete;
@@ -40,15 +51,14 @@ namespace k3d {
 
         void bind(vk::CommandBuffer commandBuffer);
 
-        static PipelineConfigInfo defaultConfig(uint32_t width, uint32_t height);
+        static PipelineConfigInfo defaultConfig();
 
     private:
-        static std::vector<char> readFile(const std::string &filePath);
-
-        vk::UniquePipeline createGraphicsPipeline(const std::string &vertFilePath, const std::string &fragFilePath,
-                                                  const PipelineConfigInfo &configInfo);
+        vk::UniquePipeline createGraphicsPipeline(vk::ShaderModule vertModule, vk::ShaderModule fragModule,
+                                                  const PipelineConfigInfo &configInfo,
+                                                  const vk::SpecializationInfo *specializationInfo);
 
-        vk::UniqueShaderModule createShaderModule(const std::vector<char> &code);
+        vk::UniqueShaderModule createShaderModule(std::span<const uint32_t> code);
 
 
         Device &device;
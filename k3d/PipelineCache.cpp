@@ -0,0 +1,129 @@
+#include "PipelineCache.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+
+namespace k3d {
+    PipelineCache::PipelineCache(vk::Device device, const vk::PhysicalDeviceProperties &properties, std::string path,
+                                 bool creationFeedback)
+            : device{device}, properties{properties}, path{std::move(path)} {
+        stats_.feedbackSupported = creationFeedback;
+
+        std::vector<char> data;
+        if (!this->path.empty()) {
+            std::ifstream file(this->path, std::ios::binary);
+            if (file.is_open()) {
+                data.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+            }
+        }
+        if (!data.empty() && !isCompatible(data)) {
+            std::cerr << "pipeline cache: discarding " << this->path << ", written for another device or driver"
+                      << std::endl;
+            data.clear();
+        }
+
+        vk::PipelineCacheCreateInfo createInfo{
+                .initialDataSize = data.size(),
+                .pInitialData = data.data(),
+        };
+        try {
+            cache = device.createPipelineCacheUnique(createInfo);
+            stats_.loaded = !data.empty();
+            stats_.loadedBytes = data.size();
+        } catch (const std::exception &) {
+            // the header matched but the driver still rejected the payload, start cold
+            createInfo.initialDataSize = 0;
+            createInfo.pInitialData = nullptr;
+            try {
+                cache = device.createPipelineCacheUnique(createInfo);
+            } catch (const std::exception &e) {
+                throw std::runtime_error("failed to create pipeline cache");
+            }
+        }
+    }
+
+    PipelineCache::~PipelineCache() {
+        try {
+            save();
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << std::endl;
+        }
+    }
+
+    bool PipelineCache::isCompatible(const std::vector<char> &data) const {
+        VkPipelineCacheHeaderVersionOne header{};
+        if (data.size() < sizeof(header)) {
+            return false;
+        }
+        std::memcpy(&header, data.data(), sizeof(header));
+        return header.headerSize >= sizeof(header) &&
+               header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE &&
+               header.vendorID == properties.vendorID &&
+               header.deviceID == properties.deviceID &&
+               std::memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID.data(), VK_UUID_SIZE) == 0;
+    }
+
+    void PipelineCache::save() {
+        if (path.empty()) {
+            return;
+        }
+        auto data = device.getPipelineCacheData(cache.get());
+        std::string temporary = path + ".tmp";
+        {
+            std::ofstream file(temporary, std::ios::binary | std::ios::trunc);
+            if (!file.is_open()) {
+                throw std::runtime_error("failed to open file: " + temporary);
+            }
+            file.write(reinterpret_cast<const char *>(data.data()), static_cast<std::streamsize>(data.size()));
+            if (!file) {
+                throw std::runtime_error("failed to write file: " + temporary);
+            }
+        }
+        if (std::rename(temporary.c_str(), path.c_str()) != 0) {
+            throw std::runtime_error("failed to replace file: " + path);
+        }
+    }
+
+    template<typename CreateInfo, typename Create>
+    vk::UniquePipeline PipelineCache::create(CreateInfo createInfo, uint32_t stageCount, Create create) {
+        vk::PipelineCreationFeedbackEXT pipelineFeedback{};
+        std::vector<vk::PipelineCreationFeedbackEXT> stageFeedbacks(stageCount);
+        vk::PipelineCreationFeedbackCreateInfoEXT feedbackInfo{
+                .pNext = createInfo.pNext,
+                .pPipelineCreationFeedback = &pipelineFeedback,
+                .pipelineStageCreationFeedbackCount = stageCount,
+                .pPipelineStageCreationFeedbacks = stageFeedbacks.data(),
+        };
+        if (stats_.feedbackSupported) {
+            createInfo.pNext = &feedbackInfo;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        auto pipeline = create(createInfo);
+        auto end = std::chrono::steady_clock::now();
+
+        stats_.pipelineCount++;
+        stats_.creationMilliseconds += std::chrono::duration<double, std::milli>(end - start).count();
+        if ((pipelineFeedback.flags & vk::PipelineCreationFeedbackFlagBitsEXT::eValid) &&
+            (pipelineFeedback.flags & vk::PipelineCreationFeedbackFlagBitsEXT::eApplicationPipelineCacheHit)) {
+            stats_.hitCount++;
+        }
+        return pipeline;
+    }
+
+    vk::UniquePipeline PipelineCache::createGraphicsPipeline(vk::GraphicsPipelineCreateInfo createInfo) {
+        return create(createInfo, createInfo.stageCount, [this](const vk::GraphicsPipelineCreateInfo &info) {
+            return device.createGraphicsPipelineUnique(cache.get(), info).value;
+        });
+    }
+
+    vk::UniquePipeline PipelineCache::createComputePipeline(vk::ComputePipelineCreateInfo createInfo) {
+        return create(createInfo, 1, [this](const vk::ComputePipelineCreateInfo &info) {
+            return device.createComputePipelineUnique(cache.get(), info).value;
+        });
+    }
+} // k3d
@@ -0,0 +1,65 @@
+#ifndef K3D_PIPELINECACHE_H
+#define K3D_PIPELINECACHE_H
+
+#define VULKAN_HPP_NO_CONSTRUCTORS
+
+#include <vulkan/vulkan.hpp>
+
+#include <string>
+
+namespace k3d {
+
+    // A vk::PipelineCache shared by every pipeline of a device. It is seeded from a file when the file's header
+    // matches the device, and written back on destruction, so warm starts and resizes skip shader compilation.
+    class PipelineCache {
+    public:
+        struct Stats {
+            // the cache was seeded from a valid file
+            bool loaded;
+            size_t loadedBytes;
+            uint32_t pipelineCount;
+            // pipelines the driver reported as cache hits, only counted with VK_EXT_pipeline_creation_feedback
+            uint32_t hitCount;
+            bool feedbackSupported;
+            double creationMilliseconds;
+        };
+
+        // an empty path keeps the cache in memory only
+        PipelineCache(vk::Device device, const vk::PhysicalDeviceProperties &properties, std::string path,
+                      bool creationFeedback);
+
+        ~PipelineCache();
+
+        PipelineCache(const PipelineCache &) = delete;
+
+        PipelineCache &operator=(const PipelineCache &) = delete;
+
+        [[nodiscard]] vk::PipelineCache get() const { return cache.get(); }
+
+        vk::UniquePipeline createGraphicsPipeline(vk::GraphicsPipelineCreateInfo createInfo);
+
+        vk::UniquePipeline createComputePipeline(vk::ComputePipelineCreateInfo createInfo);
+
+        // writes the cache to its file through a temporary, so a crash never leaves a truncated cache behind
+        void save();
+
+        [[nodiscard]] const Stats &stats() const { return stats_; }
+
+    private:
+        // false if data was written by another driver, device or cache version
+        [[nodiscard]] bool isCompatible(const std::vector<char> &data) const;
+
+        // chains creation feedback into createInfo if supported, then runs create and records the result
+        template<typename CreateInfo, typename Create>
+        vk::UniquePipeline create(CreateInfo createInfo, uint32_t stageCount, Create create);
+
+        vk::Device device;
+        vk::PhysicalDeviceProperties properties;
+        std::string path;
+        vk::UniquePipelineCache cache;
+        Stats stats_{};
+    };
+
+} // k3d
+
+#endif //K3D_PIPELINECACHE_H
@@ -0,0 +1,134 @@
+#include "PipelineRegistry.h"
+
+#include <type_traits>
+#include <vector>
+
+namespace k3d {
+    namespace {
+        class KeyWriter {
+        public:
+            template<typename T>
+            KeyWriter &operator<<(const T &value) {
+                static_assert(std::is_trivially_copyable_v<T>);
+                key.append(reinterpret_cast<const char *>(&value), sizeof(T));
+                return *this;
+            }
+
+            std::string key;
+        };
+    }
+
+    PipelineRegistry::PipelineRegistry(Device &device) : device{device} {
+    }
+
+    // pipelines go first, modules are only needed while a pipeline is created
+    PipelineRegistry::~PipelineRegistry() = default;
+
+    Pipeline &PipelineRegistry::get(std::span<const uint32_t> vertCode, std::span<const uint32_t> fragCode,
+                                    const PipelineConfigInfo &configInfo, const SpecializationConstants &constants) {
+        auto vertModule = shaderModule(vertCode);
+        auto fragModule = shaderModule(fragCode);
+        auto key = pipelineKey(vertModule, fragModule, configInfo, constants);
+        if (auto found = pipelines.find(key); found != pipelines.end()) {
+            stats_.hits++;
+            return *found->second;
+        }
+
+        std::vector<vk::SpecializationMapEntry> mapEntries;
+        std::vector<uint32_t> values;
+        for (auto [id, value]: constants) {
+            mapEntries.push_back({
+                    .constantID = id,
+                    .offset = static_cast<uint32_t>(values.size() * sizeof(uint32_t)),
+                    .size = sizeof(uint32_t),
+            });
+            values.push_back(value);
+        }
+        vk::SpecializationInfo specializationInfo{
+                .mapEntryCount = static_cast<uint32_t>(mapEntries.size()),
+                .pMapEntries = mapEntries.data(),
+                .dataSize = values.size() * sizeof(uint32_t),
+                .pData = values.data(),
+        };
+        auto pipeline = std::make_unique<Pipeline>(device, vertModule, fragModule, configInfo,
+                                                   constants.empty() ? nullptr : &specializationInfo);
+        stats_.pipelines++;
+        return *pipelines.emplace(std::move(key), std::move(pipeline)).first->second;
+    }
+
+    vk::ShaderModule PipelineRegistry::shaderModule(std::span<const uint32_t> code) {
+        std::string key{reinterpret_cast<const char *>(code.data()), code.size_bytes()};
+        if (auto found = shaderModules.find(key); found != shaderModules.end()) {
+            return found->second.get();
+        }
+        vk::ShaderModuleCreateInfo createInfo{
+                .codeSize = code.size_bytes(),
+                .pCode = code.data(),
+        };
+        vk::UniqueShaderModule module;
+        try {
+            module = device.device().createShaderModuleUnique(createInfo);
+        } catch (const std::exception &e) {
+            throw std::runtime_error("unable to create shader module");
+        }
+        stats_.shaderModules++;
+        return shaderModules.emplace(std::move(key), std::move(module)).first->second.get();
+    }
+
+    std::string PipelineRegistry::pipelineKey(vk::ShaderModule vertModule, vk::ShaderModule fragModule,
+                                              const PipelineConfigInfo &configInfo,
+                                              const SpecializationConstants &constants) {
+        // modules are unique per SPIR-V, so their handles identify the code
+        KeyWriter writer;
+        writer << static_cast<VkShaderModule>(vertModule) << static_cast<VkShaderModule>(fragModule);
+
+        writer << configInfo.bindingDescriptions.size();
+        for (const auto &binding: configInfo.bindingDescriptions) {
+            writer << binding.binding << binding.stride << binding.inputRate;
+        }
+        writer << configInfo.attributeDescriptions.size();
+        for (const auto &attribute: configInfo.attributeDescriptions) {
+            writer << attribute.location << attribute.binding << attribute.format << attribute.offset;
+        }
+
+        const auto &inputAssembly = configInfo.inputAssemblyInfo;
+        writer << inputAssembly.topology << inputAssembly.primitiveRestartEnable;
+
+        const auto &rasterization = configInfo.rasterizationInfo;
+        writer << rasterization.depthClampEnable << rasterization.rasterizerDiscardEnable
+               << rasterization.polygonMode << rasterization.cullMode << rasterization.frontFace
+               << rasterization.depthBiasEnable << rasterization.depthBiasConstantFactor
+               << rasterization.depthBiasClamp << rasterization.depthBiasSlopeFactor << rasterization.lineWidth;
+
+        const auto &multisample = configInfo.multisampleInfo;
+        writer << multisample.rasterizationSamples << multisample.sampleShadingEnable << multisample.minSampleShading
+               << multisample.alphaToCoverageEnable << multisample.alphaToOneEnable
+               << (multisample.pSampleMask ? *multisample.pSampleMask : ~vk::SampleMask{0});
+
+        const auto &blend = configInfo.colorBlendAttachment;
+        writer << blend.blendEnable << blend.srcColorBlendFactor << blend.dstColorBlendFactor << blend.colorBlendOp
+               << blend.srcAlphaBlendFactor << blend.dstAlphaBlendFactor << blend.alphaBlendOp << blend.colorWriteMask;
+        const auto &blendState = configInfo.colorBlendInfo;
+        writer << blendState.logicOpEnable << blendState.logicOp << blendState.attachmentCount;
+        for (float constant: blendState.blendConstants) {
+            writer << constant;
+        }
+
+        const auto &depthStencil = configInfo.depthStencilInfo;
+        writer << depthStencil.depthTestEnable << depthStencil.depthWriteEnable << depthStencil.depthCompareOp
+               << depthStencil.depthBoundsTestEnable << depthStencil.stencilTestEnable
+               << depthStencil.front << depthStencil.back
+               << depthStencil.minDepthBounds << depthStencil.maxDepthBounds;
+
+        writer << configInfo.dynamicStates.size();
+        for (auto state: configInfo.dynamicStates) {
+            writer << state;
+        }
+        writer << static_cast<VkPipelineLayout>(configInfo.pipelineLayout) << configInfo.subpass;
+
+        for (auto [id, value]: constants) {
+            writer << id << value;
+        }
+        return std::move(writer.key);
+    }
+} // k3d
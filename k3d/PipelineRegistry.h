@@ -0,0 +1,60 @@
+#ifndef K3D_PIPELINEREGISTRY_H
+#define K3D_PIPELINEREGISTRY_H
+
+#include "Pipeline.h"
+
+#include <map>
+#include <memory>
+#include <span>
+#include <string>
+#include <unordered_map>
+
+namespace k3d {
+
+    // 32-bit specialization constant values by constant id, applied to every stage of a pipeline
+    using SpecializationConstants = std::map<uint32_t, uint32_t>;
+
+    // Hands out one Pipeline per distinct combination of shaders, PipelineConfigInfo and specialization constants,
+    // and one shader module per distinct SPIR-V shared by all of them. Keys leave out the render pass handle, so
+    // every pipeline of a registry must be used with render passes compatible with the one it was created for;
+    // an incompatible render pass needs a registry of its own.
+    class PipelineRegistry {
+    public:
+        struct Stats {
+            uint32_t shaderModules;
+            uint32_t pipelines;
+            // get() calls answered with an existing pipeline
+            uint64_t hits;
+        };
+
+        explicit PipelineRegistry(Device &device);
+
+        ~PipelineRegistry();
+
+        PipelineRegistry(const PipelineRegistry &) = delete;
+
+        PipelineRegistry &operator=(const PipelineRegistry &) = delete;
+
+        // the pipeline stays valid for the lifetime of the registry
+        Pipeline &get(std::span<const uint32_t> vertCode, std::span<const uint32_t> fragCode,
+                      const PipelineConfigInfo &configInfo, const SpecializationConstants &constants = {});
+
+        [[nodiscard]] const Stats &stats() const { return stats_; }
+
+    private:
+        vk::ShaderModule shaderModule(std::span<const uint32_t> code);
+
+        // every field of configInfo that affects the created pipeline, written out in a fixed order
+        static std::string pipelineKey(vk::ShaderModule vertModule, vk::ShaderModule fragModule,
+                                       const PipelineConfigInfo &configInfo, const SpecializationConstants &constants);
+
+        Device &device;
+        // keyed by the SPIR-V bytes themselves
+        std::unordered_map<std::string, vk::UniqueShaderModule> shaderModules;
+        std::unordered_map<std::string, std::unique_ptr<Pipeline>> pipelines;
+        Stats stats_{};
+    };
+
+} // k3d
+
+#endif //K3D_PIPELINEREGISTRY_H
@@ -0,0 +1,29 @@
+#include "ShaderCode.h"
+
+#include <cstdlib>
+#include <fstream>
+#include <stdexcept>
+
+namespace k3d {
+    ShaderCode::ShaderCode(const std::string &fileName, std::span<const uint32_t> embedded) : embedded{embedded} {
+        if (const char *directory = std::getenv("K3D_SHADER_DIR"); directory != nullptr && *directory != '\0') {
+            loaded = readFile(std::string{directory} + "/" + fileName);
+        }
+    }
+
+    std::vector<uint32_t> ShaderCode::readFile(const std::string &filePath) {
+        std::ifstream file(filePath, std::ios::ate | std::ios::binary);
+        if (!file.is_open()) {
+            throw std::runtime_error("failed to open file: " + filePath);
+        }
+        std::streamsize fileSize = file.tellg();
+        if (fileSize <= 0 || fileSize % sizeof(uint32_t) != 0) {
+            throw std::runtime_error("not a SPIR-V file: " + filePath);
+        }
+        // read as words, so the code is aligned the way vkCreateShaderModule requires
+        std::vector<uint32_t> buffer(fileSize / sizeof(uint32_t));
+        file.seekg(0);
+        file.read(reinterpret_cast<char *>(buffer.data()), fileSize);
+        return buffer;
+    }
+} // k3d
@@ -0,0 +1,34 @@
+#ifndef K3D_SHADERCODE_H
+#define K3D_SHADERCODE_H
+
+#include <cstdint>
+#include <span>
+#include <string>
+#include <vector>
+
+namespace k3d {
+
+    // SPIR-V of one shader. The code embedded at build time is used as is, unless the K3D_SHADER_DIR environment
+    // variable names a directory, then <K3D_SHADER_DIR>/<fileName> is read instead so shaders can be recompiled
+    // during development without relinking.
+    class ShaderCode {
+    public:
+        ShaderCode(const std::string &fileName, std::span<const uint32_t> embedded);
+
+        [[nodiscard]] std::span<const uint32_t> code() const {
+            return loaded.empty() ? embedded : std::span<const uint32_t>{loaded};
+        }
+
+        // whether the code came from K3D_SHADER_DIR
+        [[nodiscard]] bool overridden() const { return !loaded.empty(); }
+
+        static std::vector<uint32_t> readFile(const std::string &filePath);
+
+    private:
+        std::vector<uint32_t> loaded;
+        std::span<const uint32_t> embedded;
+    };
+
+} // k3d
+
+#endif //K3D_SHADERCODE_H
@@ -0,0 +1,35 @@
+#include "StreamingBuffer.h"
+
+namespace k3d {
+    namespace {
+        vk::DeviceSize alignUp(vk::DeviceSize value, vk::DeviceSize alignment) {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+    }
+
+    StreamingBuffer::StreamingBuffer(Device &device, vk::BufferUsageFlags usage, uint32_t slotCount,
+                                     vk::DeviceSize slotSize)
+            // 256 is the largest offset alignment any limit may require, so every slot starts aligned
+            : slots{slotCount}, slotSize_{alignUp(slotSize, 256)} {
+        device.createBuffer(slotSize_ * slots,
+                            usage,
+                            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                            buffer_, memory);
+    }
+
+    StreamingBuffer::~StreamingBuffer() = default;
+
+    void StreamingBuffer::beginFrame(uint32_t slot) {
+        slotBegin = slotSize_ * slot;
+        cursor = slotBegin;
+    }
+
+    StreamingBuffer::Range StreamingBuffer::allocate(vk::DeviceSize size, vk::DeviceSize alignment) {
+        auto offset = alignUp(cursor, alignment);
+        if (offset + size > slotBegin + slotSize_) {
+            throw std::runtime_error("streaming buffer slot is full");
+        }
+        cursor = offset + size;
+        return {offset, static_cast<char *>(memory.mapped()) + offset};
+    }
+} // k3d
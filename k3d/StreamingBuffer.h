@@ -0,0 +1,51 @@
+#ifndef K3D_STREAMINGBUFFER_H
+#define K3D_STREAMINGBUFFER_H
+
+#include "device.h"
+
+namespace k3d {
+
+    // A persistently mapped, host visible buffer split into one region per slot, sub-allocated front to back.
+    // The caller picks slots whose previous frame has completed. Slots keyed by frame in flight or by swapchain image
+    // both qualify once SwapChain::acquireNextImage() has returned, it waits for the fences of both. Per-frame data
+    // is then written without allocations, map/unmap or stalls.
+    class StreamingBuffer {
+    public:
+        struct Range {
+            vk::DeviceSize offset;
+            void *data;
+        };
+
+        StreamingBuffer(Device &device, vk::BufferUsageFlags usage, uint32_t slotCount, vk::DeviceSize slotSize);
+
+        ~StreamingBuffer();
+
+        StreamingBuffer(const StreamingBuffer &) = delete;
+
+        StreamingBuffer &operator=(const StreamingBuffer &) = delete;
+
+        // Starts allocating at the beginning of the slot. Allocations happen in the same order every frame, so
+        // the offsets of a slot repeat and cached command buffers referencing them stay valid.
+        void beginFrame(uint32_t slot);
+
+        // throws if the current slot has no room left
+        Range allocate(vk::DeviceSize size, vk::DeviceSize alignment);
+
+        [[nodiscard]] vk::Buffer buffer() const { return buffer_.get(); }
+
+        [[nodiscard]] uint32_t slotCount() const { return slots; }
+
+        [[nodiscard]] vk::DeviceSize slotSize() const { return slotSize_; }
+
+    private:
+        uint32_t slots;
+        vk::DeviceSize slotSize_;
+        vk::UniqueBuffer buffer_;
+        Allocation memory;
+        vk::DeviceSize slotBegin = 0;
+        vk::DeviceSize cursor = 0;
+    };
+
+} // k3d
+
+#endif //K3D_STREAMINGBUFFER_H
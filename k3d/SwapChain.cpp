@@ -1,6 +1,7 @@
 #include "SwapChain.h"
 
 // std
+#include <algorithm>
 #include <array>
 #include <iostream>
 #include <limits>
@@ -8,14 +9,18 @@
 
 namespace k3d {
 
-    SwapChain::SwapChain(Device &deviceRef, vk::Extent2D extent)
-            : device{deviceRef}, windowExtent{extent} {
+    SwapChain::SwapChain(Device &deviceRef, vk::Extent2D extent, const SwapChainConfig &config, SwapChain *previous)
+            : device{deviceRef}, windowExtent{extent}, config{config}, previous{previous} {
+        if (this->config.framesInFlight == 0) {
+            throw std::runtime_error("a swapchain needs at least one frame in flight");
+        }
         createSwapChain();
         createImageViews();
         createRenderPass();
         createDepthResources();
         createFramebuffers();
         createSyncObjects();
+        this->previous = nullptr;
     }
 
     SwapChain::~SwapChain() {
@@ -24,56 +29,119 @@ namespace k3d {
         }
         swapChainImageViews.clear();
 
+        // offscreen images are owned by us, swapchain images by the swapchain
+        for (int i = 0; i < offscreenImageMemories.size(); i++) {
+            device.device().destroyImage(swapChainImages[i]);
+        }
+
         for (int i = 0; i < depthImages.size(); i++) {
             vkDestroyImageView(device.device(), depthImageViews[i], nullptr);
             vkDestroyImage(device.device(), depthImages[i], nullptr);
-            device.device().freeMemory(depthImageMemories[i]);
         }
 
-
-
-        // cleanup synchronization objects
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
-            vkDestroySemaphore(device.device(), renderFinishedSemaphores[i], nullptr);
+        for (auto semaphore: renderFinishedSemaphores) {
+            vkDestroySemaphore(device.device(), semaphore, nullptr);
+        }
+        // cleanup frame synchronization objects, unless they were handed over to a newer swapchain
+        for (size_t i = 0; i < inFlightFences.size(); i++) {
             vkDestroySemaphore(device.device(), imageAvailableSemaphores[i], nullptr);
             vkDestroyFence(device.device(), inFlightFences[i], nullptr);
         }
     }
 
-    vk::Result SwapChain::acquireNextImage(uint32_t &imageIndex) {
+    void SwapChain::waitForFrame() {
         vk::resultCheck(
                 device.device().waitForFences(inFlightFences[currentFrame], true, std::numeric_limits<uint64_t>::max()),
                 "failed to wait for fences"
         );
+    }
+
+    vk::Result SwapChain::acquireNextImage(uint32_t &imageIndex) {
+        waitForFrame();
+
+        if (device.isHeadless()) {
+            imageIndex = nextOffscreenImage;
+            nextOffscreenImage = (nextOffscreenImage + 1) % imageCount();
+            waitForImage(imageIndex);
+            return vk::Result::eSuccess;
+        }
 
         auto result = device.device().acquireNextImageKHR(swapChain.get(), std::numeric_limits<uint64_t>::max(),
                                                           imageAvailableSemaphores[currentFrame]);
         imageIndex = result.value;
+        if (result.result == vk::Result::eSuccess || result.result == vk::Result::eSuboptimalKHR) {
+            waitForImage(imageIndex);
+        }
         return result.result;
     }
 
-    vk::Result SwapChain::submitCommandBuffers(
-            const vk::CommandBuffer *buffers, uint32_t &imageIndex) {
+    void SwapChain::waitForImage(uint32_t imageIndex) {
         if (imagesInFlight[imageIndex] != VK_NULL_HANDLE) {
             vk::resultCheck(device.device().waitForFences(imagesInFlight[imageIndex], true,
                                                           std::numeric_limits<uint64_t>::max()),
                             "failed to wait for fences"
             );
         }
+    }
+
+    vk::Result SwapChain::submitCommandBuffers(
+            const vk::CommandBuffer *buffers, uint32_t &imageIndex, uint64_t uploadValue) {
         imagesInFlight[imageIndex] = inFlightFences[currentFrame];
 
         vk::SubmitInfo submitInfo = {};
 
-        vk::Semaphore waitSemaphores[] = {imageAvailableSemaphores[currentFrame]};
-        vk::PipelineStageFlags waitStages[] = {vk::PipelineStageFlagBits::eColorAttachmentOutput};
-        submitInfo.waitSemaphoreCount = 1;
-        submitInfo.pWaitSemaphores = waitSemaphores;
-        submitInfo.pWaitDstStageMask = waitStages;
+        // uploads are waited on by the GPU through the timeline semaphore, or on the CPU without one
+        auto &uploads = device.uploads();
+        if (uploadValue > 0 && !uploads.semaphore()) {
+            uploads.wait(uploadValue);
+        }
+        bool waitForUpload = uploadValue > 0 && uploads.semaphore() && uploads.completedValue() < uploadValue;
+        std::array<vk::Semaphore, 2> waitSemaphores;
+        std::array<vk::PipelineStageFlags, 2> waitStages;
+        // values are ignored for binary semaphores
+        std::array<uint64_t, 2> waitValues{};
+        uint32_t waitCount = 0;
+        if (!device.isHeadless()) {
+            waitSemaphores[waitCount] = imageAvailableSemaphores[currentFrame];
+            waitStages[waitCount++] = vk::PipelineStageFlagBits::eColorAttachmentOutput;
+        }
+        if (waitForUpload) {
+            waitSemaphores[waitCount] = uploads.semaphore();
+            waitStages[waitCount] = vk::PipelineStageFlagBits::eDrawIndirect | vk::PipelineStageFlagBits::eVertexInput |
+                                    vk::PipelineStageFlagBits::eVertexShader |
+                                    vk::PipelineStageFlagBits::eFragmentShader;
+            waitValues[waitCount++] = uploadValue;
+        }
+        vk::TimelineSemaphoreSubmitInfo timelineInfo{
+                .waitSemaphoreValueCount = waitCount,
+                .pWaitSemaphoreValues = waitValues.data(),
+        };
+        if (waitForUpload) {
+            submitInfo.pNext = &timelineInfo;
+        }
+        submitInfo.waitSemaphoreCount = waitCount;
+        submitInfo.pWaitSemaphores = waitSemaphores.data();
+        submitInfo.pWaitDstStageMask = waitStages.data();
+
+        if (device.isHeadless()) {
+            // no acquire or present to synchronize with, the fence alone guards the frame
+            submitInfo.commandBufferCount = 1;
+            submitInfo.pCommandBuffers = buffers;
+
+            device.device().resetFences(inFlightFences[currentFrame]);
+            try {
+                device.graphicsQueue().submit(submitInfo, inFlightFences[currentFrame]);
+            } catch (const std::exception &e) {
+                throw std::runtime_error("failed to submit draw command buffer!");
+            }
+            currentFrame = (currentFrame + 1) % config.framesInFlight;
+            return vk::Result::eSuccess;
+        }
 
         submitInfo.commandBufferCount = 1;
         submitInfo.pCommandBuffers = buffers;
 
-        vk::Semaphore signalSemaphores[] = {renderFinishedSemaphores[currentFrame]};
+        vk::Semaphore signalSemaphores[] = {renderFinishedSemaphores[imageIndex]};
         submitInfo.signalSemaphoreCount = 1;
         submitInfo.pSignalSemaphores = signalSemaphores;
 
@@ -95,21 +163,56 @@ namespace k3d {
 
         presentInfo.pImageIndices = &imageIndex;
 
+        // numbered presents can be waited on, see waitForPresent()
+        vk::PresentIdKHR presentIdInfo{
+                .swapchainCount = 1,
+                .pPresentIds = &presentId,
+        };
+        if (device.presentWaitSupported()) {
+            presentId++;
+            presentInfo.pNext = &presentIdInfo;
+        }
+
+        presented = true;
         auto result = device.presentQueue().presentKHR(presentInfo);
 
-        currentFrame = (currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
+        currentFrame = (currentFrame + 1) % config.framesInFlight;
 
         return result;
     }
 
+    vk::Result SwapChain::waitForPresent(uint64_t id, uint64_t timeout) {
+        return device.waitForPresent(swapChain.get(), id, timeout);
+    }
+
+    bool SwapChain::presentsCompleted() {
+        if (!presented) {
+            return true;
+        }
+        if (device.presentWaitSupported()) {
+            // presents complete in order, anything but a timeout means the last one will not hold on any longer
+            return waitForPresent(presentId, 0) != vk::Result::eTimeout;
+        }
+        device.presentQueue().waitIdle();
+        return true;
+    }
+
     void SwapChain::createSwapChain() {
+        if (device.isHeadless()) {
+            createOffscreenImages();
+            return;
+        }
+
         SwapChainSupportDetails swapChainSupport = device.getSwapChainSupport();
 
         vk::SurfaceFormatKHR surfaceFormat = chooseSwapSurfaceFormat(swapChainSupport.formats);
-        vk::PresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes);
+        vk::PresentModeKHR presentMode = chooseSwapPresentMode(swapChainSupport.presentModes, config.presentMode);
+        presentMode_ = presentMode;
         vk::Extent2D extent = chooseSwapExtent(swapChainSupport.capabilities);
 
-        uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
+        uint32_t imageCount = config.imageCount > 0
+                              ? std::max(config.imageCount, swapChainSupport.capabilities.minImageCount)
+                              : swapChainSupport.capabilities.minImageCount + 1;
         if (swapChainSupport.capabilities.maxImageCount > 0 &&
             imageCount > swapChainSupport.capabilities.maxImageCount) {
             imageCount = swapChainSupport.capabilities.maxImageCount;
@@ -144,7 +247,7 @@ namespace k3d {
         createInfo.presentMode = presentMode;
         createInfo.clipped = VK_TRUE;
 
-        createInfo.oldSwapchain = VK_NULL_HANDLE;
+        createInfo.oldSwapchain = previous != nullptr ? previous->swapChain.get() : VK_NULL_HANDLE;
 
         try {
             swapChain = device.device().createSwapchainKHRUnique(createInfo);
@@ -162,6 +265,38 @@ namespace k3d {
         swapChainExtent = extent;
     }
 
+    void SwapChain::createOffscreenImages() {
+        swapChainImageFormat = vk::Format::eR8G8B8A8Unorm;
+        swapChainExtent = windowExtent;
+
+        auto imageCount = config.imageCount > 0 ? config.imageCount : OFFSCREEN_IMAGE_COUNT;
+        swapChainImages.resize(imageCount);
+        offscreenImageMemories.resize(imageCount);
+
+        for (int i = 0; i < swapChainImages.size(); i++) {
+            vk::ImageCreateInfo imageInfo{};
+            imageInfo.imageType = vk::ImageType::e2D;
+            imageInfo.extent.width = swapChainExtent.width;
+            imageInfo.extent.height = swapChainExtent.height;
+            imageInfo.extent.depth = 1;
+            imageInfo.mipLevels = 1;
+            imageInfo.arrayLayers = 1;
+            imageInfo.format = swapChainImageFormat;
+            imageInfo.tiling = vk::ImageTiling::eOptimal;
+            imageInfo.initialLayout = vk::ImageLayout::eUndefined;
+            imageInfo.usage = vk::ImageUsageFlagBits::eColorAttachment | vk::ImageUsageFlagBits::eTransferSrc;
+            imageInfo.samples = vk::SampleCountFlagBits::e1;
+            imageInfo.sharingMode = vk::SharingMode::eExclusive;
+            imageInfo.flags = vk::ImageCreateFlags();
+
+            device.createImageWithInfo(
+                    imageInfo,
+                    vk::MemoryPropertyFlagBits::eDeviceLocal,
+                    swapChainImages[i],
+                    offscreenImageMemories[i]);
+        }
+    }
+
     void SwapChain::createImageViews() {
         swapChainImageViews.resize(swapChainImages.size());
         for (size_t i = 0; i < swapChainImages.size(); i++) {
@@ -185,7 +320,8 @@ namespace k3d {
 
     void SwapChain::createRenderPass() {
         vk::AttachmentDescription depthAttachment{};
-        depthAttachment.format = findDepthFormat();
+        swapChainDepthFormat = findDepthFormat();
+        depthAttachment.format = swapChainDepthFormat;
         depthAttachment.samples = vk::SampleCountFlagBits::e1;
         depthAttachment.loadOp = vk::AttachmentLoadOp::eClear;
         depthAttachment.storeOp = vk::AttachmentStoreOp::eDontCare;
@@ -206,7 +342,8 @@ namespace k3d {
         colorAttachment.stencilStoreOp = vk::AttachmentStoreOp::eDontCare;
         colorAttachment.stencilLoadOp = vk::AttachmentLoadOp::eDontCare;
         colorAttachment.initialLayout = vk::ImageLayout::eUndefined;
-        colorAttachment.finalLayout = vk::ImageLayout::ePresentSrcKHR;
+        colorAttachment.finalLayout = device.isHeadless() ? vk::ImageLayout::eTransferSrcOptimal
+                                                          : vk::ImageLayout::ePresentSrcKHR;
 
         vk::AttachmentReference colorAttachmentRef = {};
         colorAttachmentRef.attachment = 0;
@@ -317,20 +454,48 @@ namespace k3d {
     }
 
     void SwapChain::createSyncObjects() {
-        imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
-        inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
         imagesInFlight.resize(imageCount(), VK_NULL_HANDLE);
-
         vk::SemaphoreCreateInfo semaphoreInfo = {};
 
+        // One per image rather than per frame slot: a present waits on it, and an image is only acquired and
+        // rendered to again once its previous present is done with it. They stay with this swapchain until its
+        // presents have completed instead of moving to a newer one.
+        if (!device.isHeadless()) {
+            renderFinishedSemaphores.resize(imageCount());
+            for (auto &semaphore: renderFinishedSemaphores) {
+                try {
+                    semaphore = device.device().createSemaphore(semaphoreInfo);
+                }
+                catch (const std::exception &) {
+                    throw std::runtime_error("failed to create synchronization objects for an image!");
+                }
+            }
+        }
+
+        if (previous != nullptr) {
+            // frame slots continue where the previous swapchain left off, so waiting on a slot's fence still
+            // covers the frames submitted through the previous swapchain
+            imageAvailableSemaphores = std::move(previous->imageAvailableSemaphores);
+            inFlightFences = std::move(previous->inFlightFences);
+            currentFrame = previous->currentFrame;
+            presentId = previous->presentId;
+            if (inFlightFences.size() != config.framesInFlight) {
+                throw std::runtime_error("a replacement swapchain must keep the number of frames in flight");
+            }
+            previous->imageAvailableSemaphores.clear();
+            previous->inFlightFences.clear();
+            return;
+        }
+
+        imageAvailableSemaphores.resize(config.framesInFlight);
+        inFlightFences.resize(config.framesInFlight);
+
         vk::FenceCreateInfo fenceInfo = {};
         fenceInfo.flags = vk::FenceCreateFlagBits::eSignaled;
 
-        for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++) {
+        for (size_t i = 0; i < config.framesInFlight; i++) {
             try {
                 imageAvailableSemaphores[i] = device.device().createSemaphore(semaphoreInfo);
-                renderFinishedSemaphores[i] = device.device().createSemaphore(semaphoreInfo);
                 inFlightFences[i] = device.device().createFence(fenceInfo);
             }
             catch (const std::exception &) {
@@ -352,22 +517,15 @@ namespace k3d {
     }
 
     vk::PresentModeKHR SwapChain::chooseSwapPresentMode(
-            const std::vector<vk::PresentModeKHR> &availablePresentModes) {
+            const std::vector<vk::PresentModeKHR> &availablePresentModes, vk::PresentModeKHR preferred) {
         for (const auto &availablePresentMode: availablePresentModes) {
-            if (availablePresentMode == vk::PresentModeKHR::eMailbox) {
-                std::cout << "Present mode: Mailbox" << std::endl;
+            if (availablePresentMode == preferred) {
+                std::cerr << "Present mode: " << vk::to_string(availablePresentMode) << std::endl;
                 return availablePresentMode;
             }
         }
 
-        // for (const auto &availablePresentMode : availablePresentModes) {
-        //   if (availablePresentMode == VK_PRESENT_MODE_IMMEDIATE_KHR) {
-        //     std::cout << "Present mode: Immediate" << std::endl;
-        //     return availablePresentMode;
-        //   }
-        // }
-
-        std::cout << "Present mode: V-Sync" << std::endl;
+        std::cerr << "Present mode: V-Sync" << std::endl;
         return vk::PresentModeKHR::eFifo;
     }
 
@@ -6,16 +6,34 @@
 #include <vulkan/vulkan.hpp>
 
 // std lib headers
+#include <optional>
 #include <string>
 #include <vector>
 
 namespace k3d {
 
+    // Latency against throughput: fewer images and frames in flight shorten the queue between input and present,
+    // more of them keep the GPU busy through CPU hitches.
+    struct SwapChainConfig {
+        // used when the surface supports it, otherwise FIFO
+        vk::PresentModeKHR presentMode = vk::PresentModeKHR::eMailbox;
+        // clamped to the surface's limits, 0 requests minImageCount + 1, or OFFSCREEN_IMAGE_COUNT when headless
+        uint32_t imageCount = 0;
+        // frames the CPU may record ahead of the GPU, each with its own fence and semaphores
+        uint32_t framesInFlight = 2;
+    };
+
     class SwapChain {
     public:
-        static constexpr int MAX_FRAMES_IN_FLIGHT = 2;
+        // number of offscreen color images rendered into round-robin when the device is headless
+        static constexpr uint32_t OFFSCREEN_IMAGE_COUNT = 3;
 
-        SwapChain(Device &deviceRef, vk::Extent2D windowExtent);
+        // A previous swapchain is passed as oldSwapchain and hands over its frame fences and acquire semaphores, so
+        // it must have the same number of frames in flight. Those fences only cover queue submissions, not the
+        // presents to its images: the caller keeps it alive until the frames submitted through it have completed
+        // and presentsCompleted() holds.
+        SwapChain(Device &deviceRef, vk::Extent2D windowExtent, const SwapChainConfig &config = {},
+                  SwapChain *previous = nullptr);
 
         ~SwapChain();
 
@@ -31,6 +49,10 @@ namespace k3d {
 
         size_t imageCount() { return swapChainImages.size(); }
 
+        [[nodiscard]] size_t getCurrentFrame() const { return currentFrame; }
+
+        [[nodiscard]] uint32_t framesInFlight() const { return config.framesInFlight; }
+
         vk::Format getSwapChainImageFormat() { return swapChainImageFormat; }
 
         vk::Extent2D getSwapChainExtent() { return swapChainExtent; }
@@ -45,13 +67,47 @@ namespace k3d {
 
         vk::Format findDepthFormat();
 
+        // pipelines built against one render pass stay usable with the other if the attachment formats match
+        [[nodiscard]] bool compareSwapFormats(const SwapChain &swapChain) const {
+            return swapChain.swapChainImageFormat == swapChainImageFormat &&
+                   swapChain.swapChainDepthFormat == swapChainDepthFormat;
+        }
+
+        // waits for the fence of the current frame slot's previous frame, acquireNextImage() starts with it
+        void waitForFrame();
+
+        // Waits for the current frame slot's fence and for the last submission that rendered to the acquired
+        // image, so on return per-frame and per-image resources are no longer read by the GPU.
         vk::Result acquireNextImage(uint32_t &imageIndex);
 
-        vk::Result submitCommandBuffers(const vk::CommandBuffer *buffers, uint32_t &imageIndex);
+        // the submission waits until the device's upload context has reached uploadValue, 0 waits for nothing
+        vk::Result submitCommandBuffers(const vk::CommandBuffer *buffers, uint32_t &imageIndex,
+                                        uint64_t uploadValue = 0);
+
+        // the mode the swapchain was created with, FIFO when the surface lacks the configured one; nullopt when headless
+        [[nodiscard]] std::optional<vk::PresentModeKHR> presentMode() const { return presentMode_; }
+
+        // id of the most recent present, 0 if presents are not numbered because present wait is unsupported
+        [[nodiscard]] uint64_t lastPresentId() const { return presentId; }
+
+        // Waits up to timeout nanoseconds for the present with the given id to be displayed, 0 only polls.
+        // eSuccess once it is, eTimeout while it is still queued.
+        vk::Result waitForPresent(uint64_t id, uint64_t timeout);
+
+        // Whether every present to this swapchain is done with its images and semaphores, so it may be destroyed.
+        // With present wait this polls the last present id. Without it nothing reports present progress, so it
+        // waits for the present queue to go idle. The spec does not strictly tie that to the presentation engine
+        // releasing the images; VK_EXT_swapchain_maintenance1 present fences would close this gap but are not used.
+        bool presentsCompleted();
 
     private:
         void createSwapChain();
 
+        // waits for the fence of the frame that last rendered to the image
+        void waitForImage(uint32_t imageIndex);
+
+        void createOffscreenImages();
+
         void createImageViews();
 
         void createDepthResources();
@@ -67,32 +123,42 @@ namespace k3d {
                 const std::vector<vk::SurfaceFormatKHR> &availableFormats);
 
         static vk::PresentModeKHR chooseSwapPresentMode(
-                const std::vector<vk::PresentModeKHR> &availablePresentModes);
+                const std::vector<vk::PresentModeKHR> &availablePresentModes, vk::PresentModeKHR preferred);
 
         vk::Extent2D chooseSwapExtent(const vk::SurfaceCapabilitiesKHR &capabilities);
 
         vk::Format swapChainImageFormat;
+        vk::Format swapChainDepthFormat;
         vk::Extent2D swapChainExtent;
 
         std::vector<vk::UniqueFramebuffer> swapChainFramebuffers;
         vk::UniqueRenderPass renderPass;
 
         std::vector<vk::Image> depthImages;
-        std::vector<vk::DeviceMemory> depthImageMemories;
+        std::vector<Allocation> depthImageMemories;
         std::vector<vk::ImageView> depthImageViews;
         std::vector<vk::Image> swapChainImages;
         std::vector<vk::ImageView> swapChainImageViews;
+        std::vector<Allocation> offscreenImageMemories;
+        uint32_t nextOffscreenImage = 0;
 
         Device &device;
         vk::Extent2D windowExtent;
+        SwapChainConfig config;
 
         vk::UniqueSwapchainKHR swapChain;
+        // only set during construction
+        SwapChain *previous;
 
         std::vector<vk::Semaphore> imageAvailableSemaphores;
         std::vector<vk::Semaphore> renderFinishedSemaphores;
         std::vector<vk::Fence> inFlightFences;
         std::vector<vk::Fence> imagesInFlight;
         size_t currentFrame = 0;
+        uint64_t presentId = 0;
+        // whether anything was queued for presentation, never when headless
+        bool presented = false;
+        std::optional<vk::PresentModeKHR> presentMode_;
     };
 
 }  // namespace k3d
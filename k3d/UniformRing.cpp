@@ -0,0 +1,74 @@
+#include "UniformRing.h"
+
+#include <algorithm>
+
+namespace k3d {
+    vk::UniqueDescriptorSetLayout UniformRing::createSetLayout(Device &device, vk::ShaderStageFlags stages) {
+        vk::DescriptorSetLayoutBinding binding{
+                .binding = 0,
+                .descriptorType = vk::DescriptorType::eUniformBufferDynamic,
+                .descriptorCount = 1,
+                .stageFlags = stages,
+        };
+        vk::DescriptorSetLayoutCreateInfo layoutInfo{
+                .bindingCount = 1,
+                .pBindings = &binding,
+        };
+        try {
+            return device.device().createDescriptorSetLayoutUnique(layoutInfo);
+        } catch (const std::exception &) {
+            throw std::runtime_error("failed to create uniform descriptor set layout");
+        }
+    }
+
+    UniformRing::UniformRing(Device &device, vk::DescriptorSetLayout setLayout, uint32_t slotCount,
+                             vk::DeviceSize slotSize, vk::DeviceSize range)
+            : alignment{std::max<vk::DeviceSize>(device.properties.limits.minUniformBufferOffsetAlignment, 1)},
+              range{range},
+              ring{device, vk::BufferUsageFlagBits::eUniformBuffer, slotCount, std::max(slotSize, range)} {
+        if (range > device.properties.limits.maxUniformBufferRange) {
+            throw std::runtime_error("uniform range exceeds maxUniformBufferRange");
+        }
+
+        vk::DescriptorPoolSize poolSize{
+                .type = vk::DescriptorType::eUniformBufferDynamic,
+                .descriptorCount = 1,
+        };
+        vk::DescriptorPoolCreateInfo poolInfo{
+                .maxSets = 1,
+                .poolSizeCount = 1,
+                .pPoolSizes = &poolSize,
+        };
+        try {
+            descriptorPool = device.device().createDescriptorPoolUnique(poolInfo);
+            vk::DescriptorSetAllocateInfo allocateInfo{
+                    .descriptorPool = descriptorPool.get(),
+                    .descriptorSetCount = 1,
+                    .pSetLayouts = &setLayout,
+            };
+            set = device.device().allocateDescriptorSets(allocateInfo).front();
+        } catch (const std::exception &) {
+            throw std::runtime_error("failed to create uniform descriptor set");
+        }
+
+        vk::DescriptorBufferInfo bufferInfo{.buffer = ring.buffer(), .offset = 0, .range = range};
+        vk::WriteDescriptorSet write{
+                .dstSet = set,
+                .dstBinding = 0,
+                .descriptorCount = 1,
+                .descriptorType = vk::DescriptorType::eUniformBufferDynamic,
+                .pBufferInfo = &bufferInfo,
+        };
+        device.device().updateDescriptorSets(write, {});
+    }
+
+    UniformRing::~UniformRing() = default;
+
+    StreamingBuffer::Range UniformRing::allocate(vk::DeviceSize size) {
+        if (size > range) {
+            throw std::runtime_error("uniform block is larger than the bound range");
+        }
+        // every offset is bound with the full range, which has to stay inside the slot
+        return ring.allocate(range, alignment);
+    }
+} // k3d
@@ -0,0 +1,56 @@
+#ifndef K3D_UNIFORMRING_H
+#define K3D_UNIFORMRING_H
+
+#include "StreamingBuffer.h"
+
+#include <cstring>
+#include <type_traits>
+
+namespace k3d {
+
+    // Per-frame uniforms in a StreamingBuffer, seen by shaders through a single dynamic uniform buffer descriptor,
+    // so per-frame data costs a memcpy and a dynamic offset instead of buffer re-creation or map/unmap.
+    class UniformRing {
+    public:
+        // layout of set 0: binding 0, one dynamic uniform buffer
+        static vk::UniqueDescriptorSetLayout createSetLayout(Device &device, vk::ShaderStageFlags stages);
+
+        // range is the size bound at every dynamic offset, the largest block a single write may use
+        UniformRing(Device &device, vk::DescriptorSetLayout setLayout, uint32_t slotCount, vk::DeviceSize slotSize,
+                    vk::DeviceSize range);
+
+        ~UniformRing();
+
+        UniformRing(const UniformRing &) = delete;
+
+        UniformRing &operator=(const UniformRing &) = delete;
+
+        // see StreamingBuffer::beginFrame()
+        void beginFrame(uint32_t slot) { ring.beginFrame(slot); }
+
+        // copies data into the current slot and returns the dynamic offset it has to be bound at
+        template<typename T>
+        uint32_t write(const T &data) {
+            static_assert(std::is_trivially_copyable_v<T>);
+            auto block = allocate(sizeof(T));
+            std::memcpy(block.data, &data, sizeof(T));
+            return static_cast<uint32_t>(block.offset);
+        }
+
+        [[nodiscard]] vk::DescriptorSet descriptorSet() const { return set; }
+
+        [[nodiscard]] uint32_t slotCount() const { return ring.slotCount(); }
+
+    private:
+        StreamingBuffer::Range allocate(vk::DeviceSize size);
+
+        vk::DeviceSize alignment;
+        vk::DeviceSize range;
+        StreamingBuffer ring;
+        vk::UniqueDescriptorPool descriptorPool;
+        vk::DescriptorSet set;
+    };
+
+} // k3d
+
+#endif //K3D_UNIFORMRING_H
@@ -0,0 +1,305 @@
+#include "UploadContext.h"
+#include "device.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <iostream>
+#include <limits>
+
+namespace k3d {
+    namespace {
+        vk::DeviceSize alignUp(vk::DeviceSize value, vk::DeviceSize alignment) {
+            return (value + alignment - 1) / alignment * alignment;
+        }
+    }
+
+    UploadBatch::UploadBatch(UploadContext &context) : context{&context} {
+        assert(!context.batchOpen && "only one upload batch may be open at a time");
+        context.batchOpen = true;
+    }
+
+    UploadBatch::UploadBatch(UploadBatch &&other) noexcept
+            : context{other.context}, recording{other.recording}, lastValue{other.lastValue} {
+        other.context = nullptr;
+        other.recording = nullptr;
+    }
+
+    UploadBatch::~UploadBatch() {
+        if (context == nullptr) {
+            return;
+        }
+        try {
+            submit();
+        } catch (const std::exception &e) {
+            std::cerr << e.what() << std::endl;
+        }
+        context->batchOpen = false;
+    }
+
+    vk::CommandBuffer UploadBatch::commandBuffer() {
+        if (!recording) {
+            recording = context->beginCommandBuffer();
+        }
+        return recording;
+    }
+
+    vk::DeviceSize UploadBatch::stage(const void *data, vk::DeviceSize size) {
+        while (true) {
+            if (auto offset = context->allocateRing(size)) {
+                std::memcpy(static_cast<char *>(context->ringMemory.mapped()) + *offset, data, size);
+                return *offset;
+            }
+            // the ring is full: hand what is recorded to the GPU, then wait for the oldest staged upload
+            submit();
+            auto oldest = std::find_if(context->pending.begin(), context->pending.end(),
+                                       [](const auto &upload) { return upload.ringEnd > 0; });
+            assert(oldest != context->pending.end() && "staging ring is full without pending uploads");
+            context->wait(oldest->value);
+            context->collect();
+        }
+    }
+
+    void UploadBatch::copyBuffer(const void *data, vk::DeviceSize size, vk::Buffer dstBuffer,
+                                 vk::DeviceSize dstOffset) {
+        // larger copies go through the ring in pieces, so they never need the whole ring at once
+        constexpr vk::DeviceSize CHUNK_SIZE = UploadContext::STAGING_RING_SIZE / 4;
+        for (vk::DeviceSize done = 0; done < size; done += CHUNK_SIZE) {
+            vk::DeviceSize chunk = std::min(CHUNK_SIZE, size - done);
+            vk::DeviceSize offset = stage(static_cast<const char *>(data) + done, chunk);
+            vk::BufferCopy copyRegion{
+                    .srcOffset = offset,
+                    .dstOffset = dstOffset + done,
+                    .size = chunk,
+            };
+            commandBuffer().copyBuffer(context->ringBuffer.get(), dstBuffer, copyRegion);
+        }
+    }
+
+    void UploadBatch::copyImage(const void *data, vk::DeviceSize size, vk::Image image, uint32_t width,
+                                uint32_t height, uint32_t layerCount, vk::ImageLayout finalLayout) {
+        assert(size <= UploadContext::STAGING_RING_SIZE / 2 && "image too large for the staging ring");
+        vk::DeviceSize offset = stage(data, size);
+        auto cmd = commandBuffer();
+
+        vk::ImageSubresourceRange range{
+                .aspectMask = vk::ImageAspectFlagBits::eColor,
+                .baseMipLevel = 0,
+                .levelCount = VK_REMAINING_MIP_LEVELS,
+                .baseArrayLayer = 0,
+                .layerCount = layerCount,
+        };
+        vk::ImageMemoryBarrier toTransfer{
+                .srcAccessMask = {},
+                .dstAccessMask = vk::AccessFlagBits::eTransferWrite,
+                .oldLayout = vk::ImageLayout::eUndefined,
+                .newLayout = vk::ImageLayout::eTransferDstOptimal,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image = image,
+                .subresourceRange = range,
+        };
+        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTopOfPipe, vk::PipelineStageFlagBits::eTransfer,
+                            {}, {}, {}, toTransfer);
+
+        vk::BufferImageCopy region{
+                .bufferOffset = offset,
+                .bufferRowLength = 0,
+                .bufferImageHeight = 0,
+                .imageSubresource = {
+                        .aspectMask = vk::ImageAspectFlagBits::eColor,
+                        .mipLevel = 0,
+                        .baseArrayLayer = 0,
+                        .layerCount = layerCount,
+                },
+                .imageOffset = {0, 0, 0},
+                .imageExtent = {width, height, 1},
+        };
+        cmd.copyBufferToImage(context->ringBuffer.get(), image, vk::ImageLayout::eTransferDstOptimal, region);
+
+        // a transfer queue cannot name shader stages, the semaphore the consumer waits on orders the reads
+        vk::ImageMemoryBarrier toFinal{
+                .srcAccessMask = vk::AccessFlagBits::eTransferWrite,
+                .dstAccessMask = {},
+                .oldLayout = vk::ImageLayout::eTransferDstOptimal,
+                .newLayout = finalLayout,
+                .srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED,
+                .image = image,
+                .subresourceRange = range,
+        };
+        cmd.pipelineBarrier(vk::PipelineStageFlagBits::eTransfer, vk::PipelineStageFlagBits::eBottomOfPipe,
+                            {}, {}, {}, toFinal);
+    }
+
+    uint64_t UploadBatch::submit() {
+        if (recording) {
+            lastValue = context->submit(recording);
+            recording = nullptr;
+        }
+        return lastValue;
+    }
+
+    UploadContext::UploadContext(Device &device, uint32_t queueFamilyIndex, vk::Queue queue, bool timelineSemaphores)
+            : device{device}, queue{queue} {
+        vk::CommandPoolCreateInfo poolInfo{
+                .flags = vk::CommandPoolCreateFlagBits::eTransient,
+                .queueFamilyIndex = queueFamilyIndex,
+        };
+        try {
+            commandPool = device.device().createCommandPoolUnique(poolInfo);
+        } catch (const std::exception &) {
+            throw std::runtime_error("failed to create upload command pool");
+        }
+
+        if (timelineSemaphores) {
+            vk::SemaphoreTypeCreateInfo typeInfo{
+                    .semaphoreType = vk::SemaphoreType::eTimeline,
+                    .initialValue = 0,
+            };
+            vk::SemaphoreCreateInfo semaphoreInfo{.pNext = &typeInfo};
+            try {
+                timeline = device.device().createSemaphoreUnique(semaphoreInfo);
+            } catch (const std::exception &) {
+                throw std::runtime_error("failed to create upload timeline semaphore");
+            }
+        }
+
+        device.createBuffer(STAGING_RING_SIZE,
+                            vk::BufferUsageFlagBits::eTransferSrc,
+                            vk::MemoryPropertyFlagBits::eHostVisible | vk::MemoryPropertyFlagBits::eHostCoherent,
+                            ringBuffer, ringMemory
+        );
+        // offsets that suit buffer to image copies of any texel size up to 16 bytes
+        ringAlignment = std::max<vk::DeviceSize>(16, device.properties.limits.optimalBufferCopyOffsetAlignment);
+    }
+
+    UploadContext::~UploadContext() {
+        wait(nextValue - 1);
+        collect();
+    }
+
+    UploadBatch UploadContext::beginBatch() {
+        return UploadBatch{*this};
+    }
+
+    vk::CommandBuffer UploadContext::beginCommandBuffer() {
+        collect();
+
+        vk::CommandBufferAllocateInfo allocInfo{
+                .commandPool = commandPool.get(),
+                .level = vk::CommandBufferLevel::ePrimary,
+                .commandBufferCount = 1,
+        };
+        auto commandBuffer = device.device().allocateCommandBuffers(allocInfo).front();
+        commandBuffer.begin(vk::CommandBufferBeginInfo{
+                .flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit,
+        });
+        return commandBuffer;
+    }
+
+    uint64_t UploadContext::submit(vk::CommandBuffer commandBuffer) {
+        commandBuffer.end();
+        Pending upload{
+                .value = nextValue,
+                .commandBuffer = commandBuffer,
+                .ringEnd = ringHead,
+        };
+
+        vk::TimelineSemaphoreSubmitInfo timelineInfo{
+                .signalSemaphoreValueCount = 1,
+                .pSignalSemaphoreValues = &upload.value,
+        };
+        vk::Semaphore signalSemaphore = timeline.get();
+        vk::SubmitInfo submitInfo{
+                .pNext = timeline ? &timelineInfo : nullptr,
+                .commandBufferCount = 1,
+                .pCommandBuffers = &upload.commandBuffer,
+                .signalSemaphoreCount = timeline ? 1u : 0u,
+                .pSignalSemaphores = &signalSemaphore,
+        };
+        try {
+            if (!timeline) {
+                upload.fence = device.device().createFenceUnique({});
+            }
+            queue.submit(submitInfo, upload.fence.get());
+        } catch (const std::exception &) {
+            device.device().freeCommandBuffers(commandPool.get(), upload.commandBuffer);
+            throw std::runtime_error("failed to submit upload command buffer");
+        }
+
+        nextValue++;
+        pending.push_back(std::move(upload));
+        return pending.back().value;
+    }
+
+    std::optional<vk::DeviceSize> UploadContext::allocateRing(vk::DeviceSize size) {
+        vk::DeviceSize offset = ringHead % STAGING_RING_SIZE;
+        vk::DeviceSize aligned = alignUp(offset, ringAlignment);
+        vk::DeviceSize padding = aligned - offset;
+        if (aligned + size > STAGING_RING_SIZE) {
+            // skip the tail end of the ring and start over at its beginning
+            padding = STAGING_RING_SIZE - offset;
+            aligned = 0;
+        }
+        if (ringHead + padding + size - ringTail > STAGING_RING_SIZE) {
+            return std::nullopt;
+        }
+        ringHead += padding + size;
+        return aligned;
+    }
+
+    uint64_t UploadContext::completedValue() {
+        if (timeline) {
+            return device.device().getSemaphoreCounterValue(timeline.get());
+        }
+        // fences are polled in submission order, values complete in that order as seen from here
+        for (const auto &upload: pending) {
+            if (upload.value <= fenceCompletedValue) {
+                continue;
+            }
+            if (device.device().getFenceStatus(upload.fence.get()) != vk::Result::eSuccess) {
+                break;
+            }
+            fenceCompletedValue = upload.value;
+        }
+        return fenceCompletedValue;
+    }
+
+    void UploadContext::wait(uint64_t value) {
+        if (value == 0 || completedValue() >= value) {
+            return;
+        }
+        if (timeline) {
+            vk::Semaphore semaphore = timeline.get();
+            vk::SemaphoreWaitInfo waitInfo{
+                    .semaphoreCount = 1,
+                    .pSemaphores = &semaphore,
+                    .pValues = &value,
+            };
+            vk::resultCheck(device.device().waitSemaphores(waitInfo, std::numeric_limits<uint64_t>::max()),
+                            "failed to wait for upload");
+            return;
+        }
+        for (const auto &upload: pending) {
+            if (upload.value > value) {
+                break;
+            }
+            vk::resultCheck(device.device().waitForFences(upload.fence.get(), true,
+                                                          std::numeric_limits<uint64_t>::max()),
+                            "failed to wait for upload");
+        }
+        fenceCompletedValue = std::max(fenceCompletedValue, value);
+    }
+
+    void UploadContext::collect() {
+        uint64_t completed = completedValue();
+        while (!pending.empty() && pending.front().value <= completed) {
+            if (pending.front().ringEnd > 0) {
+                ringTail = pending.front().ringEnd;
+            }
+            device.device().freeCommandBuffers(commandPool.get(), pending.front().commandBuffer);
+            pending.pop_front();
+        }
+    }
+} // k3d
@@ -0,0 +1,126 @@
+#ifndef K3D_UPLOADCONTEXT_H
+#define K3D_UPLOADCONTEXT_H
+
+#include "MemoryAllocator.h"
+
+#include <deque>
+#include <optional>
+
+namespace k3d {
+
+    class Device;
+
+    class UploadContext;
+
+    // Collects buffer and image copies, with their layout transitions, into a single command buffer that is
+    // submitted once. Data is staged in the upload context's ring buffer; only one batch may be open at a time.
+    class UploadBatch {
+    public:
+        UploadBatch(UploadBatch &&other) noexcept;
+
+        UploadBatch &operator=(UploadBatch &&other) = delete;
+
+        UploadBatch(const UploadBatch &) = delete;
+
+        UploadBatch &operator=(const UploadBatch &) = delete;
+
+        // submits whatever was recorded but not submitted yet
+        ~UploadBatch();
+
+        void copyBuffer(const void *data, vk::DeviceSize size, vk::Buffer dstBuffer, vk::DeviceSize dstOffset = 0);
+
+        // transitions the whole image from eUndefined to eTransferDstOptimal, copies the tightly packed texels of
+        // the first mip level and transitions it to finalLayout
+        void copyImage(const void *data, vk::DeviceSize size, vk::Image image, uint32_t width, uint32_t height,
+                       uint32_t layerCount, vk::ImageLayout finalLayout = vk::ImageLayout::eShaderReadOnlyOptimal);
+
+        // submits the batch, the returned value is reached once every copy has completed; 0 if nothing was recorded
+        uint64_t submit();
+
+    private:
+        friend class UploadContext;
+
+        explicit UploadBatch(UploadContext &context);
+
+        // ring space for size bytes, submits and waits for older uploads if the ring is full
+        vk::DeviceSize stage(const void *data, vk::DeviceSize size);
+
+        vk::CommandBuffer commandBuffer();
+
+        UploadContext *context;
+        vk::CommandBuffer recording;
+        uint64_t lastValue = 0;
+    };
+
+    // Copies staged data on the transfer queue without waiting for it. Every submission returns the value a
+    // timeline semaphore reaches once its copies have completed; consumers either make their queue submission wait
+    // on that value or call wait(). Staging memory is recycled once its copies have completed.
+    // Without timeline semaphore support the values are tracked with fences and waits happen on the CPU.
+    class UploadContext {
+    public:
+        static constexpr vk::DeviceSize STAGING_RING_SIZE = 32 * 1024 * 1024;
+
+        UploadContext(Device &device, uint32_t queueFamilyIndex, vk::Queue queue, bool timelineSemaphores);
+
+        // waits for every pending upload
+        ~UploadContext();
+
+        UploadContext(const UploadContext &) = delete;
+
+        UploadContext &operator=(const UploadContext &) = delete;
+
+        UploadBatch beginBatch();
+
+        [[nodiscard]] uint64_t completedValue();
+
+        // blocks until value has been reached
+        void wait(uint64_t value);
+
+        // the timeline semaphore to wait on for a value, null when uploads are tracked with fences
+        [[nodiscard]] vk::Semaphore semaphore() const { return timeline.get(); }
+
+        // destroys the resources of completed uploads and recycles their ring space
+        void collect();
+
+        // submissions made over the context's lifetime
+        [[nodiscard]] uint64_t submitCount() const { return nextValue - 1; }
+
+    private:
+        friend class UploadBatch;
+
+        struct Pending {
+            uint64_t value;
+            vk::CommandBuffer commandBuffer;
+            vk::UniqueFence fence;
+            // ring position up to which staging memory is free once this upload completes
+            vk::DeviceSize ringEnd = 0;
+        };
+
+        vk::CommandBuffer beginCommandBuffer();
+
+        uint64_t submit(vk::CommandBuffer commandBuffer);
+
+        // offset into the ring, nullopt while the pending uploads occupy too much of it
+        std::optional<vk::DeviceSize> allocateRing(vk::DeviceSize size);
+
+        Device &device;
+        vk::Queue queue;
+        vk::UniqueCommandPool commandPool;
+        vk::UniqueSemaphore timeline;
+        uint64_t nextValue = 1;
+        // without a timeline semaphore, the highest value whose fence has been seen signaled
+        uint64_t fenceCompletedValue = 0;
+        std::deque<Pending> pending;
+
+        vk::UniqueBuffer ringBuffer;
+        Allocation ringMemory;
+        vk::DeviceSize ringAlignment;
+        // running byte counts, the ring offset is head % STAGING_RING_SIZE
+        vk::DeviceSize ringHead = 0;
+        vk::DeviceSize ringTail = 0;
+        bool batchOpen = false;
+    };
+
+} // k3d
+
+#endif //K3D_UPLOADCONTEXT_H
@@ -21,6 +21,8 @@ namespace k3d {
         window = glfwCreateWindow(width, height, windowName.c_str(), nullptr, nullptr);
         glfwSetWindowUserPointer(window, this);
         glfwSetFramebufferSizeCallback(window, framebufferResizedCallback);
+        glfwSetCursorPosCallback(window, cursorPositionCallback);
+        glfwSetScrollCallback(window, scrollCallback);
     }
 
     Window::~Window() {
@@ -40,6 +42,43 @@ namespace k3d {
         pKhr = rawSurface;
     }
 
+    void Window::resize(int w, int h) {
+        glfwSetWindowSize(window, w, h);
+    }
+
+    Window::MouseInput Window::takeMouseInput() {
+        auto input = mouse;
+        mouse.dragX = 0.0;
+        mouse.dragY = 0.0;
+        mouse.scroll = 0.0;
+        return input;
+    }
+
+    void Window::cursorPositionCallback(GLFWwindow *window, double x, double y) {
+        auto windowClass = reinterpret_cast<Window *>(glfwGetWindowUserPointer(window));
+        // cursor positions are in screen coordinates, which differ from framebuffer pixels on high DPI displays
+        int windowWidth;
+        int windowHeight;
+        glfwGetWindowSize(window, &windowWidth, &windowHeight);
+        if (windowWidth == 0 || windowHeight == 0) {
+            return;
+        }
+        double ndcX = 2.0 * x / windowWidth - 1.0;
+        double ndcY = 2.0 * y / windowHeight - 1.0;
+        auto &mouse = windowClass->mouse;
+        if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS) {
+            mouse.dragX += ndcX - mouse.cursorX;
+            mouse.dragY += ndcY - mouse.cursorY;
+        }
+        mouse.cursorX = ndcX;
+        mouse.cursorY = ndcY;
+    }
+
+    void Window::scrollCallback(GLFWwindow *window, double, double yOffset) {
+        auto windowClass = reinterpret_cast<Window *>(glfwGetWindowUserPointer(window));
+        windowClass->mouse.scroll += yOffset;
+    }
+
     void Window::framebufferResizedCallback(GLFWwindow *window, int width, int height) {
         auto windowClass = reinterpret_cast<Window *>(glfwGetWindowUserPointer(window));
         windowClass->width = width;
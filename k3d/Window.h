@@ -39,14 +39,34 @@ namespace k3d {
             framebufferResized = false;
         }
 
+        // requests a new window size, the framebuffer resize arrives through the next event poll
+        void resize(int w, int h);
+
+        struct MouseInput {
+            // cursor movement with the left button held, in normalized device coordinates
+            double dragX = 0.0;
+            double dragY = 0.0;
+            // wheel steps, positive away from the user
+            double scroll = 0.0;
+            // current cursor position in normalized device coordinates
+            double cursorX = 0.0;
+            double cursorY = 0.0;
+        };
+
+        // input accumulated by the event polls since the previous call
+        MouseInput takeMouseInput();
+
     private:
         void initWindow();
         static void framebufferResizedCallback(GLFWwindow* window, int width, int height);
+        static void cursorPositionCallback(GLFWwindow *window, double x, double y);
+        static void scrollCallback(GLFWwindow *window, double xOffset, double yOffset);
 
         std::string windowName;
         int height;
         int width;
         bool framebufferResized = false;
+        MouseInput mouse;
         GLFWwindow *window;
     };
 
@@ -47,17 +47,35 @@ namespace k3d {
     }
 
 // class member functions
-    Device::Device(Window &window) : window{window} {
+    Device::Device(Window *window, const std::string &pipelineCachePath) : window{window} {
+        if (isHeadless()) {
+            deviceExtensions.clear();
+        }
         createInstance();
         setupDebugMessenger();
-        createSurface();
+        if (!isHeadless()) {
+            createSurface();
+        }
         pickPhysicalDevice();
+        enableOptionalExtensions();
         createLogicalDevice();
         createCommandPool();
+        allocator_ = std::make_unique<MemoryAllocator>(device_.get(), physicalDevice.getMemoryProperties(),
+                                                       properties.limits.bufferImageGranularity);
+        pipelineCache_ = std::make_unique<PipelineCache>(device_.get(), properties, pipelineCachePath,
+                                                         creationFeedbackSupported);
+        auto indices = findQueueFamilies(physicalDevice);
+        uploads_ = std::make_unique<UploadContext>(*this,
+                                                   indices.transferFamily.value_or(indices.graphicsFamily.value()),
+                                                   transferQueue_, timelineSemaphoreSupported);
     }
 
     Device::~ Device() {
+        uploads_.reset();
+        pipelineCache_.reset();
+        allocator_.reset();
         device_->destroyCommandPool(commandPool);
+        device_.reset();
 
         if (enableValidationLayers) {
             DestroyDebugUtilsMessengerEXT(instance, debugMessenger, nullptr);
@@ -77,7 +95,7 @@ namespace k3d {
                 .applicationVersion = VK_MAKE_VERSION(1, 0, 0),
                 .pEngineName = "No Engine",
                 .engineVersion = VK_MAKE_VERSION(1, 0, 0),
-                .apiVersion = VK_API_VERSION_1_0,
+                .apiVersion = VK_API_VERSION_1_2,
         };
 
         vk::InstanceCreateInfo createInfo = {};
@@ -112,21 +130,25 @@ namespace k3d {
     void Device::pickPhysicalDevice() {
         auto devices = instance.enumeratePhysicalDevices();
 
-        auto found = false;
+        // prefer discrete GPUs, but fall back to integrated, virtual and CPU implementations
+        int bestRating = -1;
         for (const auto &device: devices) {
-            if (isDeviceSuitable(device)) {
+            if (!isDeviceSuitable(device)) {
+                continue;
+            }
+            int rating = rateDeviceType(device.getProperties().deviceType);
+            if (rating > bestRating) {
                 physicalDevice = device;
-                found = true;
-                break;
+                bestRating = rating;
             }
         }
 
-        if (!found) {
+        if (bestRating < 0) {
             throw std::runtime_error("failed to find a suitable GPU!");
         }
 
         properties = physicalDevice.getProperties();
-        std::cout << "physical device: " << properties.deviceName << std::endl;
+        std::cerr << "physical device: " << properties.deviceName << std::endl;
     }
 
     void Device::createLogicalDevice() {
@@ -134,6 +156,9 @@ namespace k3d {
 
         std::vector<vk::DeviceQueueCreateInfo> queueCreateInfos;
         std::set<uint32_t> uniqueQueueFamilies = {indices.graphicsFamily.value(), indices.presentFamily.value()};
+        if (indices.transferFamily) {
+            uniqueQueueFamilies.insert(indices.transferFamily.value());
+        }
 
         float queuePriority = 1.0f;
         for (uint32_t queueFamily: uniqueQueueFamilies) {
@@ -145,7 +170,9 @@ namespace k3d {
         }
 
         vk::PhysicalDeviceFeatures deviceFeatures = {};
-        deviceFeatures.samplerAnisotropy = VK_TRUE;
+        deviceFeatures.samplerAnisotropy = physicalDevice.getFeatures().samplerAnisotropy;
+        deviceFeatures.fillModeNonSolid = physicalDevice.getFeatures().fillModeNonSolid;
+        fillModeNonSolidEnabled = deviceFeatures.fillModeNonSolid;
 
         vk::DeviceCreateInfo createInfo = {};
 
@@ -153,6 +180,18 @@ namespace k3d {
         createInfo.pQueueCreateInfos = queueCreateInfos.data();
 
         createInfo.pEnabledFeatures = &deviceFeatures;
+        vk::PhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{.presentWait = true};
+        vk::PhysicalDevicePresentIdFeaturesKHR presentIdFeatures{.pNext = &presentWaitFeatures, .presentId = true};
+        vk::PhysicalDeviceVulkan12Features vulkan12Features{.timelineSemaphore = true};
+        void *features = nullptr;
+        if (presentWaitEnabled) {
+            features = &presentIdFeatures;
+        }
+        if (timelineSemaphoreSupported) {
+            vulkan12Features.pNext = features;
+            features = &vulkan12Features;
+        }
+        createInfo.pNext = features;
         createInfo.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size());
         createInfo.ppEnabledExtensionNames = deviceExtensions.data();
 
@@ -171,8 +210,21 @@ namespace k3d {
             throw std::runtime_error("failed to create logical device!");
         }
 
+        if (presentWaitEnabled) {
+            waitForPresent_ = reinterpret_cast<PFN_vkWaitForPresentKHR>(device_->getProcAddr("vkWaitForPresentKHR"));
+        }
+
         graphicsQueue_ = device_->getQueue(indices.graphicsFamily.value(), 0);
         presentQueue_ = device_->getQueue(indices.presentFamily.value(), 0);
+        transferQueue_ = indices.transferFamily ? device_->getQueue(indices.transferFamily.value(), 0)
+                                                : graphicsQueue_;
+        if (indices.transferFamily) {
+            bufferQueueFamilies = {indices.graphicsFamily.value(), indices.transferFamily.value()};
+        }
+    }
+
+    vk::Result Device::waitForPresent(vk::SwapchainKHR swapchain, uint64_t presentId, uint64_t timeout) {
+        return static_cast<vk::Result>(waitForPresent_(device_.get(), swapchain, presentId, timeout));
     }
 
     void Device::createCommandPool() {
@@ -189,24 +241,35 @@ namespace k3d {
         }
     }
 
-    void Device::createSurface() { window.createWindowSurface(instance, surface_); }
+    void Device::createSurface() { window->createWindowSurface(instance, surface_); }
 
     bool Device::isDeviceSuitable(vk::PhysicalDevice device) {
         QueueFamilyIndices indices = findQueueFamilies(device);
 
         bool extensionsSupported = checkDeviceExtensionSupport(device);
 
-        bool swapChainAdequate = false;
-        if (extensionsSupported) {
+        bool swapChainAdequate = isHeadless();
+        if (extensionsSupported && !isHeadless()) {
             SwapChainSupportDetails swapChainSupport = querySwapChainSupport(device);
             swapChainAdequate = !swapChainSupport.formats.empty() && !swapChainSupport.presentModes.empty();
         }
 
-        vk::PhysicalDeviceFeatures supportedFeatures = device.getFeatures();
+        return indices.isComplete() && extensionsSupported && swapChainAdequate;
+    }
 
-        return indices.isComplete() && extensionsSupported && swapChainAdequate &&
-               device.getProperties().deviceType == vk::PhysicalDeviceType::eDiscreteGpu &&
-               supportedFeatures.samplerAnisotropy;
+    int Device::rateDeviceType(vk::PhysicalDeviceType type) {
+        switch (type) {
+            case vk::PhysicalDeviceType::eDiscreteGpu:
+                return 4;
+            case vk::PhysicalDeviceType::eIntegratedGpu:
+                return 3;
+            case vk::PhysicalDeviceType::eVirtualGpu:
+                return 2;
+            case vk::PhysicalDeviceType::eCpu:
+                return 1;
+            default:
+                return 0;
+        }
     }
 
     void Device::populateDebugMessengerCreateInfo(
@@ -255,11 +318,13 @@ namespace k3d {
     }
 
     std::vector<const char *> Device::getRequiredExtensions() const {
-        uint32_t glfwExtensionCount = 0;
-        const char **glfwExtensions;
-        glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
-
-        std::vector<const char *> extensions(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        std::vector<const char *> extensions;
+        if (!isHeadless()) {
+            uint32_t glfwExtensionCount = 0;
+            const char **glfwExtensions;
+            glfwExtensions = glfwGetRequiredInstanceExtensions(&glfwExtensionCount);
+            extensions.assign(glfwExtensions, glfwExtensions + glfwExtensionCount);
+        }
 
         if (enableValidationLayers) {
             extensions.push_back(VK_EXT_DEBUG_UTILS_EXTENSION_NAME);
@@ -274,17 +339,17 @@ namespace k3d {
         std::vector<VkExtensionProperties> extensions(extensionCount);
         vkEnumerateInstanceExtensionProperties(nullptr, &extensionCount, extensions.data());
 
-        std::cout << "available extensions:" << std::endl;
+        std::cerr << "available extensions:" << std::endl;
         std::unordered_set<std::string> available;
         for (const auto &extension: extensions) {
-            std::cout << "\t" << extension.extensionName << std::endl;
+            std::cerr << "\t" << extension.extensionName << std::endl;
             available.insert(extension.extensionName);
         }
 
-        std::cout << "required extensions:" << std::endl;
+        std::cerr << "required extensions:" << std::endl;
         auto requiredExtensions = getRequiredExtensions();
         for (const auto &required: requiredExtensions) {
-            std::cout << "\t" << required << std::endl;
+            std::cerr << "\t" << required << std::endl;
             if (available.find(required) == available.end()) {
                 throw std::runtime_error("Missing required glfw extension");
             }
@@ -311,6 +376,40 @@ namespace k3d {
         return requiredExtensions.empty();
     }
 
+    void Device::enableOptionalExtensions() {
+        bool presentIdAvailable = false;
+        bool presentWaitAvailable = false;
+        if (properties.apiVersion >= VK_API_VERSION_1_2) {
+            auto features = physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2,
+                    vk::PhysicalDeviceVulkan12Features>();
+            timelineSemaphoreSupported = features.get<vk::PhysicalDeviceVulkan12Features>().timelineSemaphore;
+        }
+        for (const auto &extension: physicalDevice.enumerateDeviceExtensionProperties()) {
+            if (std::strcmp(extension.extensionName, VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME) == 0) {
+                deviceExtensions.push_back(VK_EXT_PIPELINE_CREATION_FEEDBACK_EXTENSION_NAME);
+                creationFeedbackSupported = true;
+            }
+            if (std::strcmp(extension.extensionName, VK_KHR_PRESENT_ID_EXTENSION_NAME) == 0) {
+                presentIdAvailable = true;
+            }
+            if (std::strcmp(extension.extensionName, VK_KHR_PRESENT_WAIT_EXTENSION_NAME) == 0) {
+                presentWaitAvailable = true;
+            }
+        }
+        // only useful for measuring present latency, so headless devices go without
+        if (!isHeadless() && presentIdAvailable && presentWaitAvailable &&
+            properties.apiVersion >= VK_API_VERSION_1_1) {
+            auto features = physicalDevice.getFeatures2<vk::PhysicalDeviceFeatures2,
+                    vk::PhysicalDevicePresentIdFeaturesKHR, vk::PhysicalDevicePresentWaitFeaturesKHR>();
+            if (features.get<vk::PhysicalDevicePresentIdFeaturesKHR>().presentId &&
+                features.get<vk::PhysicalDevicePresentWaitFeaturesKHR>().presentWait) {
+                deviceExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+                deviceExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+                presentWaitEnabled = true;
+            }
+        }
+    }
+
     QueueFamilyIndices Device::findQueueFamilies(vk::PhysicalDevice device) {
         QueueFamilyIndices indices;
 
@@ -325,6 +424,15 @@ namespace k3d {
             if (queueFamily.queueCount > 0 && queueFamily.queueFlags & VK_QUEUE_GRAPHICS_BIT) {
                 indices.graphicsFamily = i;
             }
+            if (isHeadless()) {
+                // nothing is ever presented, alias the present family so callers need no special case
+                indices.presentFamily = indices.graphicsFamily;
+                if (indices.isComplete()) {
+                    break;
+                }
+                i++;
+                continue;
+            }
             VkBool32 presentSupport = false;
             vkGetPhysicalDeviceSurfaceSupportKHR(device, i, surface_, &presentSupport);
             if (queueFamily.queueCount > 0 && presentSupport) {
@@ -337,6 +445,15 @@ namespace k3d {
             i++;
         }
 
+        for (uint32_t family = 0; family < queueFamilies.size(); family++) {
+            auto flags = queueFamilies[family].queueFlags;
+            if (queueFamilies[family].queueCount > 0 && (flags & VK_QUEUE_TRANSFER_BIT) &&
+                !(flags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+                indices.transferFamily = family;
+                break;
+            }
+        }
+
         return indices;
     }
 
@@ -351,6 +468,11 @@ namespace k3d {
         return details;
     }
 
+    uint32_t Device::timestampValidBits() {
+        auto queueFamilies = physicalDevice.getQueueFamilyProperties();
+        return queueFamilies[findPhysicalQueueFamilies().graphicsFamily.value()].timestampValidBits;
+    }
+
     vk::Format Device::findSupportedFormat(
             const std::vector<vk::Format> &candidates, vk::ImageTiling tiling, vk::FormatFeatureFlags features) {
         for (vk::Format format: candidates) {
@@ -383,11 +505,17 @@ namespace k3d {
             vk::BufferUsageFlags usage,
             vk::MemoryPropertyFlags propertyFlags,
             vk::UniqueBuffer &buffer,
-            vk::UniqueDeviceMemory &bufferMemory) {
+            Allocation &bufferMemory) {
         vk::BufferCreateInfo bufferInfo{};
         bufferInfo.size = size;
         bufferInfo.usage = usage;
         bufferInfo.sharingMode = vk::SharingMode::eExclusive;
+        if (usage & vk::BufferUsageFlagBits::eTransferDst && !bufferQueueFamilies.empty()) {
+            // filled on the transfer queue and read on the graphics queue without ownership transfers
+            bufferInfo.sharingMode = vk::SharingMode::eConcurrent;
+            bufferInfo.queueFamilyIndexCount = static_cast<uint32_t>(bufferQueueFamilies.size());
+            bufferInfo.pQueueFamilyIndices = bufferQueueFamilies.data();
+        }
 
         try {
             buffer = device_->createBufferUnique(bufferInfo);
@@ -396,110 +524,38 @@ namespace k3d {
         }
 
         vk::MemoryRequirements memRequirements = device_->getBufferMemoryRequirements(buffer.get());
+        uint32_t memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, propertyFlags);
+        bufferMemory = allocator_->allocate(memRequirements, memoryTypeIndex, true);
 
-        vk::MemoryAllocateInfo allocInfo{};
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, propertyFlags);
-
-        try {
-            bufferMemory = device_->allocateMemoryUnique(allocInfo);
-        }
-        catch (const std::exception &e) {
-            throw std::runtime_error("failed to allocate vertex buffer memory!");
-        }
-
-        device_->bindBufferMemory(buffer.get(), bufferMemory.get(), 0);
-    }
-
-
-    vk::CommandBuffer Device::beginSingleTimeCommands() {
-        vk::CommandBufferAllocateInfo allocInfo{};
-        allocInfo.level = vk::CommandBufferLevel::ePrimary;
-        allocInfo.commandPool = commandPool;
-        allocInfo.commandBufferCount = 1;
-
-        vk::CommandBuffer commandBuffer = device_->allocateCommandBuffers(allocInfo).front();
-
-        vk::CommandBufferBeginInfo beginInfo{};
-        beginInfo.flags = vk::CommandBufferUsageFlagBits::eOneTimeSubmit;
-
-        commandBuffer.begin(beginInfo);
-        return commandBuffer;
-    }
-
-    void Device::endSingleTimeCommands(vk::CommandBuffer commandBuffer) {
-        commandBuffer.end();
-
-        vk::SubmitInfo submitInfo{};
-        submitInfo.commandBufferCount = 1;
-        submitInfo.pCommandBuffers = &commandBuffer;
-
-        graphicsQueue_.submit(submitInfo);
-        graphicsQueue_.waitIdle();
-
-        device_->freeCommandBuffers(commandPool, commandBuffer);
-    }
-
-    void Device::copyBuffer(vk::Buffer srcBuffer, vk::Buffer dstBuffer, vk::DeviceSize size) {
-        vk::CommandBuffer commandBuffer = beginSingleTimeCommands();
-
-        vk::BufferCopy copyRegion{};
-        copyRegion.srcOffset = 0;  // Optional
-        copyRegion.dstOffset = 0;  // Optional
-        copyRegion.size = size;
-        commandBuffer.copyBuffer(srcBuffer, dstBuffer, copyRegion);
-
-        endSingleTimeCommands(commandBuffer);
-    }
-
-    void Device::copyBufferToImage(
-            vk::Buffer buffer, vk::Image image, uint32_t width, uint32_t height, uint32_t layerCount) {
-        vk::CommandBuffer commandBuffer = beginSingleTimeCommands();
-
-        vk::BufferImageCopy region{};
-        region.bufferOffset = 0;
-        region.bufferRowLength = 0;
-        region.bufferImageHeight = 0;
-
-        region.imageSubresource.aspectMask = vk::ImageAspectFlagBits::eColor;
-        region.imageSubresource.mipLevel = 0;
-        region.imageSubresource.baseArrayLayer = 0;
-        region.imageSubresource.layerCount = layerCount;
-
-        region.imageOffset = vk::Offset3D{0, 0, 0};
-        region.imageExtent = vk::Extent3D{width, height, 1};
-
-        commandBuffer.copyBufferToImage(buffer, image, vk::ImageLayout::eTransferDstOptimal, region);
-        endSingleTimeCommands(commandBuffer);
+        device_->bindBufferMemory(buffer.get(), bufferMemory.memory(), bufferMemory.offset());
     }
 
     void Device::createImageWithInfo(
             const vk::ImageCreateInfo &imageInfo,
             vk::MemoryPropertyFlags propertyFlags,
             vk::Image &image,
-            vk::DeviceMemory &imageMemory) {
+            Allocation &imageMemory) {
+        vk::ImageCreateInfo createInfo = imageInfo;
+        if (createInfo.usage & vk::ImageUsageFlagBits::eTransferDst && !bufferQueueFamilies.empty()) {
+            // uploaded on the transfer queue, same as buffers
+            createInfo.sharingMode = vk::SharingMode::eConcurrent;
+            createInfo.queueFamilyIndexCount = static_cast<uint32_t>(bufferQueueFamilies.size());
+            createInfo.pQueueFamilyIndices = bufferQueueFamilies.data();
+        }
         try {
-            image = device_->createImage(imageInfo);
+            image = device_->createImage(createInfo);
         }
         catch (const std::exception &e) {
             throw std::runtime_error("failed to create image!");
         }
 
         vk::MemoryRequirements memRequirements = device_->getImageMemoryRequirements(image);
-
-        vk::MemoryAllocateInfo allocInfo{};
-        allocInfo.allocationSize = memRequirements.size;
-        allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, propertyFlags);
-
-        try {
-            imageMemory = device_->allocateMemory(allocInfo);
-        }
-        catch (const std::exception &e) {
-            throw std::runtime_error("failed to allocate image memory!");
-        }
+        uint32_t memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, propertyFlags);
+        imageMemory = allocator_->allocate(memRequirements, memoryTypeIndex,
+                                           imageInfo.tiling == vk::ImageTiling::eLinear);
 
         try {
-            device_->bindImageMemory(image, imageMemory, 0);
+            device_->bindImageMemory(image, imageMemory.memory(), imageMemory.offset());
         }
         catch (const std::exception &e) {
             throw std::runtime_error("failed to bind image memory!");
@@ -1,6 +1,9 @@
 #pragma once
 
 #include "Window.h"
+#include "MemoryAllocator.h"
+#include "PipelineCache.h"
+#include "UploadContext.h"
 
 #define VULKAN_HPP_NO_CONSTRUCTORS
 
@@ -21,6 +24,8 @@ namespace k3d {
     struct QueueFamilyIndices {
         std::optional<uint32_t> graphicsFamily;
         std::optional<uint32_t> presentFamily;
+        // a family with transfer but without graphics or compute support, usually backed by DMA engines
+        std::optional<uint32_t> transferFamily;
 
         [[nodiscard]] bool isComplete() const { return graphicsFamily.has_value() && presentFamily.has_value(); }
     };
@@ -33,7 +38,10 @@ namespace k3d {
         const bool enableValidationLayers = true;
 #endif
 
-        explicit Device(Window &window);
+        // Passing nullptr creates a headless device: no surface is created, the swapchain extension is not
+        // required and any device type is accepted, including CPU implementations such as lavapipe.
+        // The pipeline cache is loaded from and saved to pipelineCachePath, empty keeps it in memory.
+        explicit Device(Window *window, const std::string &pipelineCachePath = {});
 
         ~ Device();
 
@@ -52,16 +60,38 @@ namespace k3d {
 
         vk::SurfaceKHR surface() { return surface_; }
 
+        [[nodiscard]] bool isHeadless() const { return window == nullptr; }
+
         vk::Queue graphicsQueue() { return graphicsQueue_; }
 
         vk::Queue presentQueue() { return presentQueue_; }
 
+        MemoryAllocator &allocator() { return *allocator_; }
+
+        PipelineCache &pipelineCache() { return *pipelineCache_; }
+
+        // runs on the dedicated transfer queue when the device has one, on the graphics queue otherwise
+        UploadContext &uploads() { return *uploads_; }
+
+        [[nodiscard]] bool hasDedicatedTransferQueue() const { return transferQueue_ != graphicsQueue_; }
+
+        // VK_KHR_present_id and VK_KHR_present_wait, so presents can be numbered and waited on
+        [[nodiscard]] bool presentWaitSupported() const { return waitForPresent_ != nullptr; }
+
+        vk::Result waitForPresent(vk::SwapchainKHR swapchain, uint64_t presentId, uint64_t timeout);
+
+        // line and point polygon modes
+        [[nodiscard]] bool fillModeNonSolidSupported() const { return fillModeNonSolidEnabled; }
+
         SwapChainSupportDetails getSwapChainSupport() { return querySwapChainSupport(physicalDevice); }
 
         uint32_t findMemoryType(uint32_t typeFilter, vk::MemoryPropertyFlags propertyFlags);
 
         QueueFamilyIndices findPhysicalQueueFamilies() { return findQueueFamilies(physicalDevice); }
 
+        // valid bits of timestamps written on the graphics queue, 0 if timestamps are unsupported
+        uint32_t timestampValidBits();
+
         vk::Format findSupportedFormat(
                 const std::vector<vk::Format> &candidates, vk::ImageTiling tiling, vk::FormatFeatureFlags features);
 
@@ -71,22 +101,13 @@ namespace k3d {
                 vk::BufferUsageFlags usage,
                 vk::MemoryPropertyFlags propertyFlags,
                 vk::UniqueBuffer &buffer,
-                vk::UniqueDeviceMemory &bufferMemory);
-
-        vk::CommandBuffer beginSingleTimeCommands();
-
-        void endSingleTimeCommands(vk::CommandBuffer commandBuffer);
-
-        void copyBuffer(vk::Buffer srcBuffer, vk::Buffer dstBuffer, vk::DeviceSize size);
-
-        void copyBufferToImage(
-                vk::Buffer buffer, vk::Image image, uint32_t width, uint32_t height, uint32_t layerCount);
+                Allocation &bufferMemory);
 
         void createImageWithInfo(
                 const vk::ImageCreateInfo &imageInfo,
                 vk::MemoryPropertyFlags propertyFlags,
                 vk::Image &image,
-                vk::DeviceMemory &imageMemory);
+                Allocation &imageMemory);
 
         vk::PhysicalDeviceProperties properties;
 
@@ -103,9 +124,14 @@ namespace k3d {
 
         void createCommandPool();
 
+        // enables extensions that are used when present, must run before createLogicalDevice()
+        void enableOptionalExtensions();
+
         // helper functions
         bool isDeviceSuitable(vk::PhysicalDevice device);
 
+        static int rateDeviceType(vk::PhysicalDeviceType type);
+
         [[nodiscard]] std::vector<const char *> getRequiredExtensions() const;
 
         bool checkValidationLayerSupport();
@@ -123,16 +149,27 @@ namespace k3d {
         vk::Instance instance;
         VkDebugUtilsMessengerEXT debugMessenger{};
         vk::PhysicalDevice physicalDevice;
-        Window &window;
+        Window *window;
         vk::CommandPool commandPool;
 
         vk::UniqueDevice device_;
+        std::unique_ptr<MemoryAllocator> allocator_;
+        std::unique_ptr<PipelineCache> pipelineCache_;
+        std::unique_ptr<UploadContext> uploads_;
+        bool creationFeedbackSupported = false;
+        bool timelineSemaphoreSupported = false;
+        bool presentWaitEnabled = false;
+        bool fillModeNonSolidEnabled = false;
+        // not exported by the loader, fetched from the device once the extension is enabled
+        PFN_vkWaitForPresentKHR waitForPresent_ = nullptr;
         vk::SurfaceKHR surface_;
         vk::Queue graphicsQueue_;
         vk::Queue presentQueue_;
+        vk::Queue transferQueue_;
+        std::vector<uint32_t> bufferQueueFamilies;
 
         const std::vector<const char *> validationLayers = {"VK_LAYER_KHRONOS_validation"};
-        const std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
+        std::vector<const char *> deviceExtensions = {VK_KHR_SWAPCHAIN_EXTENSION_NAME};
     };
 
 }  // namespace lve
\ No newline at end of file
@@ -1,9 +1,72 @@
 #include <iostream>
+#include <string_view>
 #include "k3d/App.h"
+#include "k3d/Options.h"
+
+int main(int argc, char **argv) {
+    k3d::AppConfig config;
+    for (int i = 1; i < argc; i++) {
+        std::string_view arg{argv[i]};
+        if (arg == "--headless") {
+            config.headless = true;
+        } else if (arg == "--frames" && i + 1 < argc) {
+            config.frameCount = std::stoull(argv[++i]);
+        } else if (arg == "--depth" && i + 1 < argc) {
+            config.fractalDepth = std::stoi(argv[++i]);
+        } else if (arg == "--gpu-fractal" && i + 1 < argc && k3d::parseFractalKind(argv[i + 1])) {
+            config.gpuGeometry = true;
+            config.fractalKind = *k3d::parseFractalKind(argv[++i]);
+        } else if (arg == "--cache-command-buffers") {
+            config.cacheCommandBuffers = true;
+        } else if (arg == "--no-index") {
+            config.indexedGeometry = false;
+        } else if (arg == "--no-instancing") {
+            config.instancedGeometry = false;
+        } else if (arg == "--vertex-layout" && i + 1 < argc && k3d::parseVertexLayout(argv[i + 1])) {
+            config.vertexLayout = *k3d::parseVertexLayout(argv[++i]);
+        } else if (arg == "--lod" && i + 1 < argc) {
+            config.lodTargetPixels = std::stof(argv[++i]);
+        } else if (arg == "--record-threads" && i + 1 < argc) {
+            config.recordThreads = std::stoul(argv[++i]);
+        } else if (arg == "--draws" && i + 1 < argc) {
+            config.drawCount = std::stoul(argv[++i]);
+        } else if (arg == "--camera") {
+            config.camera = true;
+        } else if (arg == "--zoom-speed" && i + 1 < argc) {
+            config.camera = true;
+            config.zoomSpeed = std::stod(argv[++i]);
+        } else if (arg == "--animate") {
+            config.animate = true;
+        } else if (arg == "--stream-geometry") {
+            config.streamGeometry = true;
+        } else if (arg == "--wireframe") {
+            config.wireframe = true;
+        } else if (arg == "--present-mode" && i + 1 < argc && k3d::parsePresentMode(argv[i + 1])) {
+            config.presentMode = *k3d::parsePresentMode(argv[++i]);
+        } else if (arg == "--image-count" && i + 1 < argc) {
+            config.imageCount = std::stoul(argv[++i]);
+        } else if (arg == "--frames-in-flight" && i + 1 < argc) {
+            config.framesInFlight = std::stoul(argv[++i]);
+        } else if (arg == "--gpu-log" && i + 1 < argc) {
+            config.gpuTimingLogInterval = std::stoul(argv[++i]);
+        } else {
+            std::cerr << "usage: " << argv[0] << " [--headless] [--frames N] [--depth N]"
+                      << " [--gpu-fractal sierpinski|carpet|koch] [--cache-command-buffers] [--gpu-log N]"
+                      << " [--no-index] [--no-instancing] [--vertex-layout float32|packed|position]"
+                      << " [--lod PIXELS] [--record-threads N] [--draws N] [--camera] [--zoom-speed F]"
+                      << " [--animate] [--stream-geometry] [--wireframe]"
+                      << " [--present-mode immediate|mailbox|fifo|fifo-relaxed]"
+                      << " [--image-count N] [--frames-in-flight N]" << std::endl;
+            return EXIT_FAILURE;
+        }
+    }
+    if (config.headless && config.frameCount == 0) {
+        std::cerr << "--headless requires --frames N" << std::endl;
+        return EXIT_FAILURE;
+    }
 
-int main() {
-    k3d::App app;
     try {
+        k3d::App app{config};
         app.run();
     } catch (const std::exception &e) {
         std::cerr << e.what() << std::endl;
@@ -3,9 +3,31 @@
 layout (location = 0) in vec2 position;
 layout (location = 1) in vec3 color;
 
+layout (location = 2) in vec2 instanceOffset;
+layout (location = 3) in float instanceScale;
+layout (location = 4) in vec3 instanceColorBias;
+
 layout (location = 0) out vec3 fragColor;
 
+// App::ViewTransform, places the model on screen after the instance transform
+layout (push_constant) uniform View {
+    vec2 offset;
+    float scale;
+    float colorScale;
+    vec3 colorBias;
+} view;
+
+// App::FrameUniforms, written once per frame into the uniform ring and bound at a dynamic offset
+layout (set = 0, binding = 0) uniform Frame {
+    vec4 colorScale;
+    vec2 offset;
+    float scale;
+    float time;
+} frame;
+
 void main() {
-    gl_Position = vec4(position, 0.0, 1.0);
-    fragColor = color;
-}
\ No newline at end of file
+    vec2 p = position * instanceScale + instanceOffset;
+    gl_Position = vec4((p * view.scale + view.offset) * frame.scale + frame.offset, 0.0, 1.0);
+    vec3 c = (color * instanceScale + instanceColorBias) * view.colorScale + view.colorBias;
+    fragColor = c * frame.colorScale.rgb;
+}
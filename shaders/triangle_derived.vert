@@ -0,0 +1,37 @@
+#version 450
+
+// triangle.vert for VertexLayout::PositionOnly, the color is derived from the position like sierpinskiColor()
+layout (location = 0) in vec2 position;
+
+layout (location = 2) in vec2 instanceOffset;
+layout (location = 3) in float instanceScale;
+layout (location = 4) in vec3 instanceColorBias;
+
+layout (location = 0) out vec3 fragColor;
+
+// App::ViewTransform, places the model on screen after the instance transform
+layout (push_constant) uniform View {
+    vec2 offset;
+    float scale;
+    float colorScale;
+    vec3 colorBias;
+} view;
+
+// App::FrameUniforms, written once per frame into the uniform ring and bound at a dynamic offset
+layout (set = 0, binding = 0) uniform Frame {
+    vec4 colorScale;
+    vec2 offset;
+    float scale;
+    float time;
+} frame;
+
+vec3 colorAt(vec2 p) {
+    return vec3((p.x + 1.0) / 2.0, (p.y + 1.0) / 2.0, (p.x + p.y + 2.0) / 4.0);
+}
+
+void main() {
+    vec2 p = position * instanceScale + instanceOffset;
+    gl_Position = vec4((p * view.scale + view.offset) * frame.scale + frame.offset, 0.0, 1.0);
+    vec3 color = (colorAt(position) * instanceScale + instanceColorBias) * view.colorScale + view.colorBias;
+    fragColor = color * frame.colorScale.rgb;
+}